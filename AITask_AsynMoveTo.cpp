@@ -9,12 +9,26 @@
 #include "AIResources.h"
 #include "NavigationSystem.h"
 #include "NavigationSystemTypes.h"
+#include "NavMesh/RecastNavMesh.h"
 #include "../Actors/VillagerController.h"
-#include "ShoniCrowdManager.h"
+#include "Navigation/CrowdFollowingComponent.h"
+#include "ShoniPathScheduler.h"
+#include "ShoniPathCache.h"
+#include "ShoniFlowField.h"
+#include "ShoniNavHierarchy.h"
+#include "ShoniSignificanceManager.h"
+#include "ShoniPathStats.h"
+#include "ShoniPathSmoothing.h"
 #include "GameplayTasksComponent.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PawnMovementComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
 
 DEFINE_LOG_CATEGORY(LogMoveToError);
 
+TMap<TObjectKey<UCrowdFollowingComponent>, int32> UAITask_AsyncMoveTo::CrowdSuppressionCounts;
+
 UAITask_AsyncMoveTo::UAITask_AsyncMoveTo(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
 {
@@ -31,6 +45,18 @@ UAITask_AsyncMoveTo::UAITask_AsyncMoveTo(const FObjectInitializer& ObjectInitial
 	
 	MoveResult = EPathFollowingResult::Invalid;
 	bUseContinuousTracking = false;
+	bSuppressingCrowd = false;
+	bUseFlowField = false;
+	bPrefetchingSegment = false;
+	bAwaitingSegment = false;
+	bCorridorFailed = false;
+	bRetryingMove = false;
+	bUseInterimPath = false;
+	bFollowingInterim = false;
+	bUseMoveLOD = false;
+	bSimulatingMove = false;
+	bLODSuppressingCrowd = false;
+	bUsePathSmoothing = false;
 }
 
 UAITask_AsyncMoveTo* UAITask_AsyncMoveTo::AIMoveTo(AAIController* Controller, FVector InGoalLocation, AActor* InGoalActor,
@@ -83,6 +109,26 @@ void UAITask_AsyncMoveTo::SetContinuousGoalTracking(bool bEnable)
 	bUseContinuousTracking = bEnable;
 }
 
+void UAITask_AsyncMoveTo::SetUseFlowField(bool bEnable)
+{
+	bUseFlowField = bEnable;
+}
+
+void UAITask_AsyncMoveTo::SetUseInterimPath(bool bEnable)
+{
+	bUseInterimPath = bEnable;
+}
+
+void UAITask_AsyncMoveTo::SetUseMoveLOD(bool bEnable)
+{
+	bUseMoveLOD = bEnable;
+}
+
+void UAITask_AsyncMoveTo::SetUsePathSmoothing(bool bEnable)
+{
+	bUsePathSmoothing = bEnable;
+}
+
 void UAITask_AsyncMoveTo::FinishMoveTask(EPathFollowingResult::Type InResult)
 {
 	if (MoveRequestID.IsValid())
@@ -129,6 +175,10 @@ void UAITask_AsyncMoveTo::ConditionalPerformMove()
 	if (MoveRequest.IsUsingPathfinding() && OwnerController && OwnerController->ShouldPostponePathUpdates())
 	{
 		UE_VLOG(GetGameplayTasksComponent(), LogGameplayTasks, Log, TEXT("%s> can't path right now, waiting..."), *GetName());
+		if (UShoniPathStats* Stats = UShoniPathStats::Get(GetWorld()))
+		{
+			Stats->RecordRetry(false);
+		}
 		OwnerController->GetWorldTimerManager().SetTimer(MoveRetryTimerHandle, this, &UAITask_AsyncMoveTo::ConditionalPerformMove, 0.2f, false);
 	}
 	else
@@ -149,6 +199,10 @@ void UAITask_AsyncMoveTo::PerformMove()
 
 	ResetObservers();
 	ResetTimers();
+	// superseded, stop it costing worker time. RVO stays locked for the new request
+	AbortPathQuery();
+
+	PathRequestTime = FPlatformTime::Seconds();
 
     FPathFindingQuery NavQuery;
     if (!OwnerController->BuildPathfindingQuery(MoveRequest, NavQuery))
@@ -164,21 +218,257 @@ void UAITask_AsyncMoveTo::PerformMove()
         return;
     }
 
-	// block RVO from interfering with pathfinding
-	UShoniCrowdManager::SetAsyncInFlight(OwnerController->GetWorld(), true);
+	// a tracked goal is headed off where it is going rather than chased where it was
+	if (bUseContinuousTracking && MoveRequest.IsMoveToActorRequest())
+	{
+		FNavLocation ProjectedGoal;
+		if (NavSys->ProjectPointToNavigation(PredictGoalLocation(), ProjectedGoal, INVALID_NAVEXTENT, NavQuery.NavData.Get(), NavQuery.QueryFilter))
+		{
+			NavQuery.EndLocation = ProjectedGoal.Location;
+		}
+	}
+	// every branch below issues a query or a path. A retry of the same move after a failed corridor isn't a repath
+	if (!bRetryingMove)
+	{
+		UShoniPathStats* Stats = UShoniPathStats::Get(GetWorld());
+		if (Stats && NumPerformedMoves > 0)
+		{
+			Stats->RecordRepath();
+		}
+		++NumPerformedMoves;
+	}
+	bRetryingMove = false;
+	LastRepathTime = GetWorld()->GetTimeSeconds();
+	PendingPathQuery = NavQuery;
+	CorridorWaypoints.Reset();
+	CorridorSegment = INDEX_NONE;
+	NextSegmentPath.Reset();
+	bPrefetchingSegment = false;
+	bAwaitingSegment = false;
+	bFollowingInterim = false;
+	bSimulatingMove = false;
+
+	// agents nobody can see pay for less of the movement stack, or none of it
+	ApplyMoveLOD(bUseMoveLOD ? ComputeMoveLOD() : MLOD_Full);
+	if (bUseMoveLOD)
+	{
+		OwnerController->GetWorldTimerManager().SetTimer(MoveLODTimerHandle, this, &UAITask_AsyncMoveTo::CheckMoveLOD, MOVE_LOD_CHECK_INTERVAL, false);
+	}
+	if (CurrentMoveLOD == MLOD_Simulated && MoveRequest.IsUsingPathfinding())
+	{
+		StartSimulatedMove(NavQuery);
+		return;
+	}
+
+	// crowds converging on one goal share a single field instead of a search each
+	UShoniFlowFieldManager* FlowFields = bUseFlowField ? UShoniFlowFieldManager::Get(GetWorld()) : nullptr;
+	if (FlowFields)
+	{
+		const uint32 Generation = ++PathQueryGeneration;
+		TSharedPtr<const FShoniFlowField> Field = FlowFields->RequestField(NavQuery, MoveRequest.GetNavigationFilter(),
+			FOnShoniFlowFieldReady::CreateUObject(this, &UAITask_AsyncMoveTo::OnFlowFieldReady, Generation));
+		if (Field.IsValid())
+		{
+			OnFlowFieldReady(Field, Generation);
+		}
+		else if (bUseInterimPath && CurrentMoveLOD == MLOD_Full)
+		{
+			StartInterimMove();
+		}
+		return;
+	}
+
+	// long cross-island moves search the region graph first, then only ever path a few regions ahead
+	UShoniNavHierarchy* Hierarchy = !bCorridorFailed && MoveRequest.IsUsingPathfinding() ? UShoniNavHierarchy::Get(GetWorld()) : nullptr;
+	if (Hierarchy && Hierarchy->FindCorridor(NavQuery, CorridorWaypoints))
+	{
+		CorridorSegment = 0;
+		PendingPathQuery.EndLocation = CorridorWaypoints[0];
+	}
+
+	RequestPathQuery();
+}
+
+void UAITask_AsyncMoveTo::RequestPathQuery(bool bSuppressCrowd)
+{
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	if (!NavSys)
+	{
+		FinishMoveTask(EPathFollowingResult::Invalid);
+		return;
+	}
+
+	// common trips are served straight from the shared cache without touching the navmesh workers
+	UShoniPathCache* PathCache = UShoniPathCache::Get(GetWorld());
+	if (FNavPathSharedPtr CachedPath = PathCache ? PathCache->FindPath(PendingPathQuery, MoveRequest.GetNavigationFilter()) : nullptr)
+	{
+		OnAsynPathResult(INVALID_NAVQUERYID, ENavigationQueryResult::Success, CachedPath, ++PathQueryGeneration);
+		return;
+	}
+
+	// at reduced LOD a straight line will do wherever the navmesh allows one
+	ARecastNavMesh* NavMesh = CurrentMoveLOD != MLOD_Full ? Cast<ARecastNavMesh>(NavSys->GetNavDataForProps(PendingPathQuery.NavAgentProperties)) : nullptr;
+	FVector HitLocation;
+	if (NavMesh && !NavMesh->Raycast(PendingPathQuery.StartLocation, PendingPathQuery.EndLocation, HitLocation, PendingPathQuery.QueryFilter))
+	{
+		OnAsynPathResult(INVALID_NAVQUERYID, ENavigationQueryResult::Success, MakeStraightPath(*NavMesh, PendingPathQuery.EndLocation), ++PathQueryGeneration);
+		return;
+	}
+
+	// block RVO from interfering with pathfinding, only for this agent. Not while it walks the segment before this one
+	if (bSuppressCrowd)
+	{
+		SetCrowdSuppressed(true);
+	}
     // 3) Kick off async
-    const uint32 QueryID = NavSys->FindPathAsync(
-        NavQuery.NavAgentProperties,
-        NavQuery,
-        FNavPathQueryDelegate::CreateUObject(this, &UAITask_AsyncMoveTo::OnAsynPathResult),
-        EPathFindingMode::Regular
-    );
+    const FNavPathQueryDelegate ResultDelegate = FNavPathQueryDelegate::CreateUObject(this, &UAITask_AsyncMoveTo::OnAsynPathResult, ++PathQueryGeneration);
+    if (UShoniPathScheduler* Scheduler = UShoniPathScheduler::Get(GetWorld()))
+    {
+        // goes out when the frame's budget allows
+        PathRequestTicket = Scheduler->RequestPath(OwnerController->GetPawn(), PendingPathQuery, ResultDelegate, EPathFindingMode::Regular);
+    }
+    else
+    {
+        InFlightQueryID = NavSys->FindPathAsync(PendingPathQuery.NavAgentProperties, PendingPathQuery, ResultDelegate, EPathFindingMode::Regular);
+    }
+
+	const bool bQueried = PathRequestTicket != 0 || InFlightQueryID != INVALID_NAVQUERYID;
+	UShoniPathStats* Stats = UShoniPathStats::Get(GetWorld());
+	if (Stats && bQueried)
+	{
+		Stats->RecordQueryStarted();
+	}
+
+	// get going rather than stand still for however many frames the query takes
+	if (bSuppressCrowd && bUseInterimPath && CurrentMoveLOD == MLOD_Full && bQueried)
+	{
+		StartInterimMove();
+	}
+}
+
+void UAITask_AsyncMoveTo::OnFlowFieldReady(TSharedPtr<const FShoniFlowField> Field, uint32 Generation)
+{
+	if (Generation != PathQueryGeneration)
+	{
+		return;
+	}
+
+	UShoniFlowFieldManager* FlowFields = UShoniFlowFieldManager::Get(GetWorld());
+	FNavPathSharedPtr FlowPath = Field.IsValid() && FlowFields ? FlowFields->BuildPath(*Field, PendingPathQuery) : nullptr;
+	if (FlowPath.IsValid())
+	{
+		OnAsynPathResult(INVALID_NAVQUERYID, ENavigationQueryResult::Success, FlowPath, Generation);
+		return;
+	}
+
+	// outside the field, or none could be built towards this goal
+	RequestPathQuery();
+}
+
+bool UAITask_AsyncMoveTo::AbortPathQuery()
+{
+	UShoniPathStats* Stats = UShoniPathStats::Get(GetWorld());
+	if (Stats && (PathRequestTicket != 0 || InFlightQueryID != INVALID_NAVQUERYID))
+	{
+		Stats->RecordQueryEnded();
+	}
+	bool bHadQuery = false;
+	if (PathRequestTicket != 0)
+	{
+		UShoniPathScheduler* Scheduler = UShoniPathScheduler::Get(GetWorld());
+		bHadQuery = Scheduler && Scheduler->CancelRequest(PathRequestTicket);
+	}
+	else if (InFlightQueryID != INVALID_NAVQUERYID)
+	{
+		// a worker that already picked it up still delivers, the generation check drops it
+		if (UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()))
+		{
+			NavSys->AbortAsyncFindPathRequest(InFlightQueryID);
+		}
+		bHadQuery = true;
+	}
+	PathRequestTicket = 0;
+	InFlightQueryID = INVALID_NAVQUERYID;
+	// anything still on its way back, including flow fields being built, is stale from here on
+	++PathQueryGeneration;
+	return bHadQuery;
+}
+
+void UAITask_AsyncMoveTo::SetCrowdSuppressed(bool bSuppress)
+{
+	if (bSuppress == (bool)bSuppressingCrowd)
+	{
+		return;
+	}
+	bSuppressingCrowd = bSuppress;
+
+	if (bSuppress)
+	{
+		SuppressedCrowdComp = AcquireCrowdSuppression();
+		return;
+	}
+	ReleaseCrowdSuppression(SuppressedCrowdComp);
+	SuppressedCrowdComp = TObjectKey<UCrowdFollowingComponent>();
+}
+
+TObjectKey<UCrowdFollowingComponent> UAITask_AsyncMoveTo::AcquireCrowdSuppression() const
+{
+	UCrowdFollowingComponent* CrowdComp = OwnerController ? Cast<UCrowdFollowingComponent>(OwnerController->GetPathFollowingComponent()) : nullptr;
+	// counted, the agent's previous task or this one's LOD may already hold it
+	if (CrowdComp && CrowdSuppressionCounts.FindOrAdd(TObjectKey<UCrowdFollowingComponent>(CrowdComp))++ == 0)
+	{
+		CrowdComp->SuspendCrowdSteering(true);
+	}
+	return TObjectKey<UCrowdFollowingComponent>(CrowdComp);
+}
+
+void UAITask_AsyncMoveTo::ReleaseCrowdSuppression(const TObjectKey<UCrowdFollowingComponent>& CrowdKey)
+{
+	int32* Count = CrowdSuppressionCounts.Find(CrowdKey);
+	if (Count && --(*Count) <= 0)
+	{
+		CrowdSuppressionCounts.Remove(CrowdKey);
+		if (UCrowdFollowingComponent* CrowdComp = CrowdKey.ResolveObjectPtr())
+		{
+			CrowdComp->SuspendCrowdSteering(false);
+		}
+	}
 }
 
-void UAITask_AsyncMoveTo::OnAsynPathResult(uint32 QueryID, ENavigationQueryResult::Type Result, FNavPathSharedPtr _Path)
+void UAITask_AsyncMoveTo::OnAsynPathResult(uint32 QueryID, ENavigationQueryResult::Type Result, FNavPathSharedPtr _Path, uint32 Generation)
 {
+	if (Generation != PathQueryGeneration)
+	{
+		UE_VLOG(GetGameplayTasksComponent(), LogGameplayTasks, Log, TEXT("%s> dropping stale path result %u"), *GetName(), QueryID);
+		return;
+	}
+	const double ResultTime = FPlatformTime::Seconds();
+	const bool bQueried = PathRequestTicket != 0 || InFlightQueryID != INVALID_NAVQUERYID;
+	UShoniPathStats* Stats = UShoniPathStats::Get(GetWorld());
+	if (Stats)
+	{
+		if (bQueried)
+		{
+			Stats->RecordQueryEnded();
+		}
+		if (Result != ENavigationQueryResult::Success)
+		{
+			Stats->RecordPathResult(PathRequestTime, ResultTime, ResultTime, Result, nullptr, bQueried);
+		}
+	}
+	PathRequestTicket = 0;
+	InFlightQueryID = INVALID_NAVQUERYID;
 	// switch RVO back on
-	UShoniCrowdManager::SetAsyncInFlight(OwnerController->GetWorld(), false);
+	SetCrowdSuppressed(false);
+	if (Result != ENavigationQueryResult::Success && CorridorSegment != INDEX_NONE)
+	{
+		// the region graph ignores filters so a segment can be unreachable, replan this move with a flat search
+		UE_VLOG(GetGameplayTasksComponent(), LogGameplayTasks, Log, TEXT("%s> corridor segment %i failed, falling back to a flat search"), *GetName(), CorridorSegment);
+		bCorridorFailed = true;
+		bRetryingMove = true;
+		PerformMove();
+		return;
+	}
     switch (Result)
     {
     case ENavigationQueryResult::Error:
@@ -198,11 +488,512 @@ void UAITask_AsyncMoveTo::OnAsynPathResult(uint32 QueryID, ENavigationQueryResul
         return;
     }
 
-    UPathFollowingComponent* PFComp = OwnerController->GetPathFollowingComponent();
-    MoveRequestID = PFComp->RequestMove(MoveRequest, _Path);
+    // cache hits come through with no query id, everything else is worth sharing
+    UShoniPathCache* PathCache = UShoniPathCache::Get(GetWorld());
+    if (PathCache && QueryID != INVALID_NAVQUERYID)
+    {
+        PathCache->AddPath(PendingPathQuery, MoveRequest.GetNavigationFilter(), _Path);
+    }
+
+	// the interim move carries on until the real path is actually handed over
+	if (bFollowingInterim && !bPrefetchingSegment)
+	{
+		SpliceFromAgent(_Path);
+	}
+
+	if (CorridorSegment != INDEX_NONE)
+	{
+		// segments are timed up to the result, the hand-off of a prefetched one waits on the agent
+		if (Stats)
+		{
+			Stats->RecordPathResult(PathRequestTime, ResultTime, FPlatformTime::Seconds(), Result, _Path.Get(), bQueried);
+		}
+		if (!bPrefetchingSegment)
+		{
+			FollowCorridorSegment(_Path);
+			return;
+		}
+		bPrefetchingSegment = false;
+		NextSegmentPath = _Path;
+		if (bAwaitingSegment)
+		{
+			AdvanceCorridor();
+		}
+		return;
+	}
+
+	// reduced LOD agents aren't worth the frame budget, their paths are mostly straight lines anyway
+	UShoniPathSmoother* Smoother = bUsePathSmoothing && CurrentMoveLOD == MLOD_Full ? UShoniPathSmoother::Get(GetWorld()) : nullptr;
+	if (Smoother)
+	{
+		Smoother->Smooth(_Path, OwnerController->GetUniqueID());
+	}
+	FollowPath(_Path, ResultTime, bQueried);
+}
+
+void UAITask_AsyncMoveTo::FollowPath(FNavPathSharedPtr InPath, double ResultTime, bool bQueried)
+{
+	bFollowingInterim = false;
+	UPathFollowingComponent* PFComp = OwnerController->GetPathFollowingComponent();
+	MoveRequestID = PFComp->RequestMove(MoveRequest, InPath);
+	if (UShoniPathStats* Stats = UShoniPathStats::Get(GetWorld()))
+	{
+		Stats->RecordPathResult(PathRequestTime, ResultTime, FPlatformTime::Seconds(), ENavigationQueryResult::Success, InPath.Get(), bQueried);
+	}
 
-    PathFinishDelegateHandle = PFComp->OnRequestFinished.AddUObject(this, &UAITask_AsyncMoveTo::OnRequestFinished);
-    SetObservedPath(_Path);
+	if (!PathFinishDelegateHandle.IsValid())
+	{
+		PathFinishDelegateHandle = PFComp->OnRequestFinished.AddUObject(this, &UAITask_AsyncMoveTo::OnRequestFinished);
+	}
+	SetObservedPath(InPath);
+}
+
+void UAITask_AsyncMoveTo::FollowCorridorSegment(FNavPathSharedPtr InPath)
+{
+	bFollowingInterim = false;
+	UPathFollowingComponent* PFComp = OwnerController->GetPathFollowingComponent();
+	if (CorridorSegment == CorridorWaypoints.Num() - 1)
+	{
+		MoveRequestID = PFComp->RequestMove(MoveRequest, InPath);
+	}
+	else
+	{
+		FAIMoveRequest SegmentRequest(CorridorWaypoints[CorridorSegment]);
+		SegmentRequest.SetNavigationFilter(MoveRequest.GetNavigationFilter());
+		SegmentRequest.SetAllowPartialPath(MoveRequest.IsUsingPartialPaths());
+		SegmentRequest.SetAcceptanceRadius(CORRIDOR_WAYPOINT_RADIUS);
+		SegmentRequest.SetReachTestIncludesAgentRadius(true);
+		// waypoints are portal midpoints, already on the navmesh
+		SegmentRequest.SetProjectGoalLocation(false);
+		MoveRequestID = PFComp->RequestMove(SegmentRequest, InPath);
+	}
+
+	if (!PathFinishDelegateHandle.IsValid())
+	{
+		PathFinishDelegateHandle = PFComp->OnRequestFinished.AddUObject(this, &UAITask_AsyncMoveTo::OnRequestFinished);
+	}
+	SetObservedPath(InPath);
+
+	// fetch the next segment while this one is walked
+	if (CorridorSegment + 1 < CorridorWaypoints.Num())
+	{
+		PendingPathQuery.StartLocation = CorridorWaypoints[CorridorSegment];
+		PendingPathQuery.EndLocation = CorridorWaypoints[CorridorSegment + 1];
+		bPrefetchingSegment = true;
+		PathRequestTime = FPlatformTime::Seconds();
+		RequestPathQuery(false);
+	}
+}
+
+void UAITask_AsyncMoveTo::AdvanceCorridor()
+{
+	if (bPrefetchingSegment)
+	{
+		// same as any other agent waiting on its path
+		bAwaitingSegment = true;
+		SetCrowdSuppressed(true);
+		return;
+	}
+	bAwaitingSegment = false;
+
+	FNavPathSharedPtr SegmentPath = NextSegmentPath;
+	NextSegmentPath.Reset();
+	if (!SegmentPath.IsValid() || !SegmentPath->IsUpToDate())
+	{
+		// the navmesh changed under the prefetched segment, replan from here
+		PerformMove();
+		return;
+	}
+	++CorridorSegment;
+	FollowCorridorSegment(SegmentPath);
+}
+
+void UAITask_AsyncMoveTo::StartInterimMove()
+{
+	if (bFollowingInterim)
+	{
+		return;
+	}
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	ARecastNavMesh* NavMesh = NavSys ? Cast<ARecastNavMesh>(NavSys->GetNavDataForProps(PendingPathQuery.NavAgentProperties)) : nullptr;
+	UPathFollowingComponent* PFComp = OwnerController ? OwnerController->GetPathFollowingComponent() : nullptr;
+	if (!NavMesh || !PFComp)
+	{
+		return;
+	}
+
+	// straight at the goal up to the horizon, stopping short of wherever that leaves the navmesh
+	const FVector Start = PendingPathQuery.StartLocation;
+	const FVector ToGoal = PendingPathQuery.EndLocation - Start;
+	const float GoalDist = ToGoal.Size();
+	if (GoalDist < INTERIM_MIN_LENGTH)
+	{
+		return;
+	}
+	const FVector Dir = ToGoal / GoalDist;
+	FVector End = Start + Dir * FMath::Min(GoalDist, INTERIM_HORIZON);
+	FVector HitLocation;
+	if (NavMesh->Raycast(Start, End, HitLocation, PendingPathQuery.QueryFilter))
+	{
+		End = HitLocation - Dir * PendingPathQuery.NavAgentProperties.AgentRadius;
+	}
+	if (FVector::DistSquared(Start, End) < FMath::Square(INTERIM_MIN_LENGTH))
+	{
+		return;
+	}
+
+	FNavPathSharedPtr Interim = MakeStraightPath(*NavMesh, End);
+	FAIMoveRequest InterimRequest(End);
+	InterimRequest.SetNavigationFilter(MoveRequest.GetNavigationFilter());
+	InterimRequest.SetAllowPartialPath(true);
+	InterimRequest.SetProjectGoalLocation(false);
+	const FAIRequestID InterimRequestID = PFComp->RequestMove(InterimRequest, Interim);
+	if (!InterimRequestID.IsValid())
+	{
+		return;
+	}
+	MoveRequestID = InterimRequestID;
+	bFollowingInterim = true;
+	if (!PathFinishDelegateHandle.IsValid())
+	{
+		PathFinishDelegateHandle = PFComp->OnRequestFinished.AddUObject(this, &UAITask_AsyncMoveTo::OnRequestFinished);
+	}
+	UE_VLOG(GetGameplayTasksComponent(), LogGameplayTasks, Log, TEXT("%s> walking %.0f interim while the path is pending"), *GetName(), FVector::Dist(Start, End));
+}
+
+FNavPathSharedPtr UAITask_AsyncMoveTo::MakeStraightPath(ARecastNavMesh& NavMesh, const FVector& End) const
+{
+	const FVector Start = PendingPathQuery.StartLocation;
+	const FVector Extent = NavMesh.GetDefaultQueryExtent();
+	TSharedPtr<FNavMeshPath> NewPath = MakeShared<FNavMeshPath>();
+	NewPath->GetPathPoints().Add(FNavPathPoint(Start, NavMesh.FindNearestPoly(Start, Extent, PendingPathQuery.QueryFilter)));
+	NewPath->GetPathPoints().Add(FNavPathPoint(End, NavMesh.FindNearestPoly(End, Extent, PendingPathQuery.QueryFilter)));
+	NewPath->SetNavigationDataUsed(&NavMesh);
+	NewPath->SetQuerier(OwnerController);
+	NewPath->SetTimeStamp(NavMesh.GetWorldTimeStamp());
+	NewPath->SetFilter(PendingPathQuery.QueryFilter);
+	NewPath->MarkReady();
+	return NewPath;
+}
+
+void UAITask_AsyncMoveTo::SpliceFromAgent(FNavPathSharedPtr InPath) const
+{
+	FNavMeshPath* NavPath = InPath.IsValid() ? InPath->CastPath<FNavMeshPath>() : nullptr;
+	const ARecastNavMesh* NavMesh = NavPath ? Cast<ARecastNavMesh>(NavPath->GetNavigationDataUsed()) : nullptr;
+	if (!NavMesh || !OwnerController || NavPath->GetPathPoints().Num() < 2)
+	{
+		return;
+	}
+	TArray<FNavPathPoint>& Points = NavPath->GetPathPoints();
+
+	const FVector AgentLocation = OwnerController->GetNavAgentLocation();
+	const NavNodeRef AgentPoly = NavMesh->FindNearestPoly(AgentLocation, NavMesh->GetDefaultQueryExtent(), NavPath->GetFilter());
+	FVector HitLocation;
+	if (NavMesh->Raycast(AgentLocation, Points[1].Location, HitLocation, NavPath->GetFilter()))
+	{
+		// can't cut across to the first corner, head back along the interim line to the original start
+		Points.Insert(FNavPathPoint(AgentLocation, AgentPoly), 0);
+		return;
+	}
+
+	// skip corners the agent can already see past
+	int32 FirstCorner = 1;
+	while (FirstCorner < FMath::Min(Points.Num() - 1, INTERIM_SPLICE_LOOKAHEAD + 1)
+		&& !NavMesh->Raycast(AgentLocation, Points[FirstCorner + 1].Location, HitLocation, NavPath->GetFilter()))
+	{
+		++FirstCorner;
+	}
+	Points.RemoveAt(1, FirstCorner - 1, false);
+	Points[0] = FNavPathPoint(AgentLocation, AgentPoly);
+
+	// the corridor starts where the agent now is, if that's on it
+	const int32 CorridorStart = NavPath->PathCorridor.Find(AgentPoly);
+	if (CorridorStart > 0)
+	{
+		NavPath->PathCorridor.RemoveAt(0, CorridorStart, false);
+		if (NavPath->PathCorridorCost.Num() >= CorridorStart)
+		{
+			NavPath->PathCorridorCost.RemoveAt(0, CorridorStart, false);
+		}
+	}
+}
+
+FVector UAITask_AsyncMoveTo::PredictGoalLocation() const
+{
+	const AActor* GoalActor = MoveRequest.GetGoalActor();
+	if (!GoalActor)
+	{
+		return MoveRequest.GetGoalLocation();
+	}
+	const FVector GoalLocation = GoalActor->GetActorLocation();
+	const APawn* Pawn = OwnerController ? OwnerController->GetPawn() : nullptr;
+	const UPawnMovementComponent* MoveComp = Pawn ? Pawn->GetMovementComponent() : nullptr;
+	const float Speed = MoveComp ? MoveComp->GetMaxSpeed() : 0.f;
+	if (Speed <= KINDA_SMALL_NUMBER)
+	{
+		return GoalLocation;
+	}
+	// look ahead by about as long as it takes to get there
+	const float Lookahead = FMath::Min(FVector::Dist(Pawn->GetActorLocation(), GoalLocation) / Speed, GOAL_PREDICTION_TIME);
+	return GoalLocation + GoalActor->GetVelocity() * Lookahead;
+}
+
+void UAITask_AsyncMoveTo::ScheduleGoalCheck()
+{
+	const AActor* GoalActor = MoveRequest.GetGoalActor();
+	if (!OwnerController || !GoalActor)
+	{
+		return;
+	}
+	const float GoalDist = FVector::Dist(OwnerController->GetNavAgentLocation(), GoalActor->GetActorLocation());
+	const float Delay = FMath::GetMappedRangeValueClamped(FVector2D(0.f, GOAL_CHECK_FAR_DISTANCE), FVector2D(MIN_GOAL_CHECK_INTERVAL, MAX_GOAL_CHECK_INTERVAL), GoalDist);
+	OwnerController->GetWorldTimerManager().SetTimer(GoalCheckTimerHandle, this, &UAITask_AsyncMoveTo::CheckGoalMoved, Delay, false);
+}
+
+void UAITask_AsyncMoveTo::CheckGoalMoved()
+{
+	GoalCheckTimerHandle.Invalidate();
+	if (!IsActive() || !Path.IsValid() || !OwnerController || !MoveRequest.GetGoalActor())
+	{
+		return;
+	}
+	// a search is already on its way, or this segment of a corridor doesn't end at the goal
+	if (PathRequestTicket != 0 || InFlightQueryID != INVALID_NAVQUERYID || (CorridorSegment != INDEX_NONE && CorridorSegment < CorridorWaypoints.Num() - 1))
+	{
+		ScheduleGoalCheck();
+		return;
+	}
+
+	// measured on the navmesh like the path end, or the goal's height above it reads as drift
+	const ANavigationData* NavData = Path->GetNavigationDataUsed();
+	FNavLocation Goal(PredictGoalLocation());
+	const bool bGoalOnNavMesh = NavData && NavData->ProjectPoint(Goal.Location, Goal, NavData->GetDefaultQueryExtent(), Path->GetFilter());
+	// the further off the goal is, the more it may wander before the path is worth fixing
+	const float Drift = FVector::Dist(Goal.Location, Path->GetEndLocation());
+	const float Threshold = FMath::Max(MoveRequest.GetAcceptanceRadius(), FVector::Dist(OwnerController->GetNavAgentLocation(), Goal.Location) * REPATH_DISTANCE_RATIO);
+	if (Drift > Threshold)
+	{
+		if (bGoalOnNavMesh && Drift < END_CORRECTION_DISTANCE && CorrectPathEnd(Goal))
+		{
+			UE_VLOG(GetGameplayTasksComponent(), LogGameplayTasks, Log, TEXT("%s> goal drifted %.0f, moved the path end"), *GetName(), Drift);
+		}
+		else if (GetWorld()->GetTimeSeconds() - LastRepathTime >= MIN_REPATH_INTERVAL)
+		{
+			UE_VLOG(GetGameplayTasksComponent(), LogGameplayTasks, Log, TEXT("%s> goal drifted %.0f, repathing"), *GetName(), Drift);
+			LastGoalLocation = MoveRequest.GetGoalActor()->GetActorLocation();
+			PerformMove();
+			return;
+		}
+	}
+	ScheduleGoalCheck();
+}
+
+bool UAITask_AsyncMoveTo::CorrectPathEnd(const FNavLocation& NewGoal)
+{
+	FNavMeshPath* NavPath = Path.IsValid() ? Path->CastPath<FNavMeshPath>() : nullptr;
+	const ARecastNavMesh* NavMesh = NavPath ? Cast<ARecastNavMesh>(NavPath->GetNavigationDataUsed()) : nullptr;
+	UPathFollowingComponent* PFComp = OwnerController ? OwnerController->GetPathFollowingComponent() : nullptr;
+	if (!NavMesh || !PFComp || NavPath->GetPathPoints().Num() < 2 || NavPath->PathCorridor.Num() == 0)
+	{
+		return false;
+	}
+	TArray<FNavPathPoint>& Points = NavPath->GetPathPoints();
+
+	// the last leg has to stay a straight line
+	FVector HitLocation;
+	if (NavMesh->Raycast(Points[Points.Num() - 2].Location, NewGoal.Location, HitLocation, NavPath->GetFilter()))
+	{
+		return false;
+	}
+	// and the corridor may grow by one poly at most
+	const NavNodeRef GoalPoly = NewGoal.NodeRef;
+	if (GoalPoly == INVALID_NAVNODEREF)
+	{
+		return false;
+	}
+	if (GoalPoly != NavPath->PathCorridor.Last())
+	{
+		TArray<FNavigationPortalEdge> Edges;
+		NavMesh->GetPolyNeighbors(NavPath->PathCorridor.Last(), Edges);
+		if (!Edges.ContainsByPredicate([GoalPoly](const FNavigationPortalEdge& Edge) { return Edge.ToRef == GoalPoly; }))
+		{
+			return false;
+		}
+		NavPath->PathCorridor.Add(GoalPoly);
+		if (NavPath->PathCorridorCost.Num())
+		{
+			NavPath->PathCorridorCost.Add(FVector::Dist(Points.Last().Location, NewGoal.Location));
+		}
+	}
+	Points.Last() = FNavPathPoint(NewGoal.Location, GoalPoly);
+
+	// same path object handed over again from where the agent is, the NewRequest abort is ignored
+	SpliceFromAgent(Path);
+	MoveRequestID = PFComp->RequestMove(MoveRequest, Path);
+	return MoveRequestID.IsValid();
+}
+
+EMoveLOD UAITask_AsyncMoveTo::ComputeMoveLOD() const
+{
+	APawn* Pawn = OwnerController ? OwnerController->GetPawn() : nullptr;
+	// without a significance score there's nothing to say the agent is unimportant
+	if (!Pawn || !UShoniSignificanceManager::IsRegistered(Pawn))
+	{
+		return MLOD_Full;
+	}
+	const float Significance = UShoniSignificanceManager::GetSignificance(Pawn);
+	if (Significance >= FULL_LOD_SIGNIFICANCE)
+	{
+		return MLOD_Full;
+	}
+	if (Pawn->WasRecentlyRendered(SIMULATE_UNSEEN_TIME))
+	{
+		return MLOD_Reduced;
+	}
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PC = It->Get();
+		if (PC && PC->PlayerCameraManager && FVector::Dist(PC->PlayerCameraManager->GetCameraLocation(), Pawn->GetActorLocation()) < SIMULATE_MIN_CAMERA_DISTANCE)
+		{
+			return MLOD_Reduced;
+		}
+	}
+	return MLOD_Simulated;
+}
+
+void UAITask_AsyncMoveTo::ApplyMoveLOD(EMoveLOD LOD)
+{
+	CurrentMoveLOD = LOD;
+	UPathFollowingComponent* PFComp = OwnerController ? OwnerController->GetPathFollowingComponent() : nullptr;
+	if (LOD == MLOD_Full)
+	{
+		if (PFComp && DefaultPFTickInterval >= 0.f)
+		{
+			PFComp->SetComponentTickInterval(DefaultPFTickInterval);
+		}
+		DefaultPFTickInterval = -1.f;
+		if (bLODSuppressingCrowd)
+		{
+			ReleaseCrowdSuppression(LODSuppressedCrowdComp);
+			LODSuppressedCrowdComp = TObjectKey<UCrowdFollowingComponent>();
+			bLODSuppressingCrowd = false;
+		}
+		return;
+	}
+
+	if (PFComp && DefaultPFTickInterval < 0.f)
+	{
+		DefaultPFTickInterval = PFComp->GetComponentTickInterval();
+		PFComp->SetComponentTickInterval(FMath::Max(DefaultPFTickInterval, REDUCED_PF_TICK_INTERVAL));
+	}
+	// nobody is watching them avoid each other
+	if (!bLODSuppressingCrowd)
+	{
+		LODSuppressedCrowdComp = AcquireCrowdSuppression();
+		bLODSuppressingCrowd = true;
+	}
+}
+
+void UAITask_AsyncMoveTo::CheckMoveLOD()
+{
+	MoveLODTimerHandle.Invalidate();
+	if (!IsActive() || !OwnerController)
+	{
+		return;
+	}
+
+	const EMoveLOD NewLOD = ComputeMoveLOD();
+	if (NewLOD != CurrentMoveLOD)
+	{
+		if (bSimulatingMove)
+		{
+			ResumeFromSimulation();
+			return;
+		}
+		if (NewLOD == MLOD_Simulated)
+		{
+			// stand down and simulate the rest of the trip from here
+			PerformMove();
+			return;
+		}
+		ApplyMoveLOD(NewLOD);
+	}
+	OwnerController->GetWorldTimerManager().SetTimer(MoveLODTimerHandle, this, &UAITask_AsyncMoveTo::CheckMoveLOD, MOVE_LOD_CHECK_INTERVAL, false);
+}
+
+void UAITask_AsyncMoveTo::StartSimulatedMove(const FPathFindingQuery& NavQuery)
+{
+	UPathFollowingComponent* PFComp = OwnerController->GetPathFollowingComponent();
+	if (MoveRequestID.IsValid() && PFComp->GetStatus() != EPathFollowingStatus::Idle)
+	{
+		PFComp->AbortMove(*this, FPathFollowingResultFlags::NewRequest, MoveRequestID);
+	}
+	MoveRequestID = FAIRequestID::InvalidRequest;
+
+	const APawn* Pawn = OwnerController->GetPawn();
+	const UPawnMovementComponent* MoveComp = Pawn ? Pawn->GetMovementComponent() : nullptr;
+	const float Speed = MoveComp ? MoveComp->GetMaxSpeed() : 0.f;
+	SimulatedStart = NavQuery.StartLocation;
+	SimulatedEnd = NavQuery.EndLocation;
+	SimulatedStartTime = GetWorld()->GetTimeSeconds();
+	SimulatedDuration = Speed > KINDA_SMALL_NUMBER ? FVector::Dist(SimulatedStart, SimulatedEnd) * SIMULATED_DETOUR_FACTOR / Speed : 0.f;
+	bSimulatingMove = true;
+	UE_VLOG(GetGameplayTasksComponent(), LogGameplayTasks, Log, TEXT("%s> simulating a %.1fs trip"), *GetName(), SimulatedDuration);
+
+	if (SimulatedDuration <= 0.f)
+	{
+		GetWorld()->GetTimerManager().SetTimerForNextTick(this, &UAITask_AsyncMoveTo::OnSimulatedArrival);
+		return;
+	}
+	OwnerController->GetWorldTimerManager().SetTimer(SimulatedArrivalHandle, this, &UAITask_AsyncMoveTo::OnSimulatedArrival, SimulatedDuration, false);
+}
+
+void UAITask_AsyncMoveTo::OnSimulatedArrival()
+{
+	SimulatedArrivalHandle.Invalidate();
+	if (!bSimulatingMove)
+	{
+		return;
+	}
+	bSimulatingMove = false;
+
+	// an actor goal may have wandered off in the meantime, arrive where it is now
+	const AActor* GoalActor = MoveRequest.GetGoalActor();
+	const FVector Goal = GoalActor ? GoalActor->GetActorLocation() : SimulatedEnd;
+	SnapAgentTo(Goal);
+
+	if (bUseContinuousTracking && GoalActor && !Goal.Equals(LastGoalLocation, MoveRequest.GetAcceptanceRadius()))
+	{
+		LastGoalLocation = Goal;
+		OwnerController->GetWorldTimerManager().SetTimer(MoveRetryTimerHandle, this, &UAITask_AsyncMoveTo::PerformMove, MIN_REPATH_INTERVAL, false);
+		return;
+	}
+	FinishMoveTask(EPathFollowingResult::Success);
+}
+
+void UAITask_AsyncMoveTo::ResumeFromSimulation()
+{
+	OwnerController->GetWorldTimerManager().ClearTimer(SimulatedArrivalHandle);
+	bSimulatingMove = false;
+	const float Alpha = SimulatedDuration > 0.f ? FMath::Clamp((GetWorld()->GetTimeSeconds() - SimulatedStartTime) / SimulatedDuration, 0.f, 1.f) : 1.f;
+	SnapAgentTo(FMath::Lerp(SimulatedStart, SimulatedEnd, Alpha));
+	UE_VLOG(GetGameplayTasksComponent(), LogGameplayTasks, Log, TEXT("%s> significant again %.0f%% into a simulated trip"), *GetName(), Alpha * 100.f);
+	PerformMove();
+}
+
+void UAITask_AsyncMoveTo::SnapAgentTo(const FVector& Location) const
+{
+	APawn* Pawn = OwnerController ? OwnerController->GetPawn() : nullptr;
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	FNavLocation NavLocation;
+	if (!Pawn || !NavSys || !NavSys->ProjectPointToNavigation(Location, NavLocation, INVALID_NAVEXTENT, PendingPathQuery.NavData.Get()))
+	{
+		return;
+	}
+	// nav locations sit on the floor, face the way the trip was going
+	const FVector Heading = SimulatedEnd - SimulatedStart;
+	const FRotator Rotation = Heading.IsNearlyZero() ? Pawn->GetActorRotation() : FRotator(0.f, Heading.Rotation().Yaw, 0.f);
+	Pawn->TeleportTo(NavLocation.Location + FVector(0.f, 0.f, Pawn->GetDefaultHalfHeight()), Rotation);
 }
 
 void UAITask_AsyncMoveTo::Pause()
@@ -225,6 +1016,18 @@ void UAITask_AsyncMoveTo::Resume()
 		UE_CVLOG(MoveRequestID.IsValid(), GetGameplayTasksComponent(), LogGameplayTasks, Log, TEXT("%s> Resume move failed, starting new one."), *GetName());
 		ConditionalPerformMove();
 	}
+	else
+	{
+		// Pause cleared these along with the other timers
+		if (bUseContinuousTracking && MoveRequest.IsMoveToActorRequest())
+		{
+			ScheduleGoalCheck();
+		}
+		if (bUseMoveLOD && OwnerController)
+		{
+			OwnerController->GetWorldTimerManager().SetTimer(MoveLODTimerHandle, this, &UAITask_AsyncMoveTo::CheckMoveLOD, MOVE_LOD_CHECK_INTERVAL, false);
+		}
+	}
 }
 
 void UAITask_AsyncMoveTo::SetObservedPath(FNavPathSharedPtr InPath)
@@ -242,6 +1045,11 @@ void UAITask_AsyncMoveTo::SetObservedPath(FNavPathSharedPtr InPath)
 		// disable auto repaths, it will be handled by move task to include ShouldPostponePathUpdates condition
 		Path->EnableRecalculationOnInvalidation(false);
 		PathUpdateDelegateHandle = Path->AddObserver(FNavigationPath::FPathObserverDelegate::FDelegate::CreateUObject(this, &UAITask_AsyncMoveTo::OnPathEvent));
+
+		if (bUseContinuousTracking && MoveRequest.IsMoveToActorRequest())
+		{
+			ScheduleGoalCheck();
+		}
 	}
 }
 
@@ -283,6 +1091,9 @@ void UAITask_AsyncMoveTo::ResetTimers()
 	}
 	MoveRetryTimerHandle.Invalidate();
 	PathRetryTimerHandle.Invalidate();
+	GoalCheckTimerHandle.Invalidate();
+	SimulatedArrivalHandle.Invalidate();
+	MoveLODTimerHandle.Invalidate();
 }
 
 void UAITask_AsyncMoveTo::OnDestroy(bool bInOwnerFinished)
@@ -292,6 +1103,25 @@ void UAITask_AsyncMoveTo::OnDestroy(bool bInOwnerFinished)
 	ResetObservers();
 	ResetTimers();
 
+	// an aborted query never calls back, so release RVO here
+	AbortPathQuery();
+	SetCrowdSuppressed(false);
+	UShoniPathSmoother* Smoother = OwnerController ? UShoniPathSmoother::Get(GetWorld()) : nullptr;
+	if (Smoother)
+	{
+		Smoother->ReleaseAgent(OwnerController->GetUniqueID());
+	}
+	if (NumPerformedMoves > 0)
+	{
+		if (UShoniPathStats* Stats = UShoniPathStats::Get(GetWorld()))
+		{
+			Stats->RecordTaskFinished(GetNumRepaths());
+		}
+	}
+	// hand the agent back at full fidelity
+	bSimulatingMove = false;
+	ApplyMoveLOD(MLOD_Full);
+
 	if (MoveRequestID.IsValid())
 	{
 		UPathFollowingComponent* PFComp = OwnerController ? OwnerController->GetPathFollowingComponent() : nullptr;
@@ -319,6 +1149,20 @@ void UAITask_AsyncMoveTo::OnRequestFinished(FAIRequestID RequestID, const FPathF
 			// reset request Id, FinishMoveTask doesn't need to update path following's state
 			MoveRequestID = FAIRequestID::InvalidRequest;
 
+			if (bFollowingInterim)
+			{
+				// ran out of interim path, wait where we are for the real one
+				UE_VLOG(GetGameplayTasksComponent(), LogGameplayTasks, Log, TEXT("%s> interim move finished, waiting for path"), *GetName());
+				return;
+			}
+
+			if (Result.IsSuccess() && CorridorSegment != INDEX_NONE && CorridorSegment < CorridorWaypoints.Num() - 1)
+			{
+				// reached an intermediate waypoint, carry on into the next segment
+				AdvanceCorridor();
+				return;
+			}
+
 			if (bUseContinuousTracking && MoveRequest.IsMoveToActorRequest() && Result.IsSuccess())
 			{
 				FVector CurrGoal = MoveRequest.GetGoalActor()->GetActorLocation();
@@ -326,8 +1170,17 @@ void UAITask_AsyncMoveTo::OnRequestFinished(FAIRequestID RequestID, const FPathF
 				if (!CurrGoal.Equals(LastGoalLocation, Tolerance))
 				{
 					LastGoalLocation = CurrGoal;
-					UE_VLOG(GetGameplayTasksComponent(), LogGameplayTasks, Log, TEXT("%s> received OnRequestFinished and goal tracking is active! Moving again in next tick"), *GetName());
-					GetWorld()->GetTimerManager().SetTimerForNextTick(this, &ThisClass::PerformMove);
+					// no more than one search per MIN_REPATH_INTERVAL however quickly the goal keeps getting reached
+					const float RepathDelay = MIN_REPATH_INTERVAL - (GetWorld()->GetTimeSeconds() - LastRepathTime);
+					UE_VLOG(GetGameplayTasksComponent(), LogGameplayTasks, Log, TEXT("%s> received OnRequestFinished and goal tracking is active! Moving again in %.2fs"), *GetName(), FMath::Max(RepathDelay, 0.f));
+					if (RepathDelay > 0.f)
+					{
+						GetWorld()->GetTimerManager().SetTimer(MoveRetryTimerHandle, this, &ThisClass::PerformMove, RepathDelay, false);
+					}
+					else
+					{
+						GetWorld()->GetTimerManager().SetTimerForNextTick(this, &ThisClass::PerformMove);
+					}
 				}
 				else
 				{
@@ -353,13 +1206,16 @@ void UAITask_AsyncMoveTo::OnPathEvent(FNavigationPath* InPath, ENavPathEvent::Ty
 
 	switch (Event)
 	{
-	case ENavPathEvent::NewPath:
 	case ENavPathEvent::UpdatedDueToGoalMoved:
 		if (bUseContinuousTracking && MoveRequest.IsMoveToActorRequest())
 		{
+			// throttled like any other goal movement, and the path just handed over is no longer the one followed
 			GetWorld()->GetTimerManager().ClearTimer(PathRetryTimerHandle);
-			PerformMove();
+			CheckGoalMoved();
+			break;
 		}
+		// not tracking, only the partial check applies
+	case ENavPathEvent::NewPath:
 	case ENavPathEvent::UpdatedDueToNavigationChanged:
 		if (InPath && InPath->IsPartial() && !MoveRequest.IsUsingPartialPaths())
 		{
@@ -404,6 +1260,10 @@ void UAITask_AsyncMoveTo::ConditionalUpdatePath()
 	if (MoveRequest.IsUsingPathfinding() && OwnerController && OwnerController->ShouldPostponePathUpdates())
 	{
 		UE_VLOG(GetGameplayTasksComponent(), LogGameplayTasks, Log, TEXT("%s> can't path right now, waiting..."), *GetName());
+		if (UShoniPathStats* Stats = UShoniPathStats::Get(GetWorld()))
+		{
+			Stats->RecordRetry(true);
+		}
 		OwnerController->GetWorldTimerManager().SetTimer(PathRetryTimerHandle, this, &UAITask_AsyncMoveTo::ConditionalUpdatePath, 0.2f, false);
 	}
 	else
@@ -6,14 +6,29 @@
 #include "Engine/EngineTypes.h"
 #include "AITypes.h"
 #include "Navigation/PathFollowingComponent.h"
+#include "NavigationData.h"
 #include "Tasks/AITask.h"
 #include "Tasks/AITask_MoveTo.h"
 #include "AITask_AsyncMoveTo.generated.h"
 
 class AAIController;
+class UCrowdFollowingComponent;
+class ARecastNavMesh;
+struct FShoniFlowField;
 
 DECLARE_LOG_CATEGORY_EXTERN(LogMoveToError, Log, All);
 
+/** how much of the movement stack an agent pays for, picked from its significance */
+enum EMoveLOD : uint8
+{
+	/** full pathfinding, path following and RVO */
+	MLOD_Full,
+	/** straight paths where the navmesh allows, slower path following ticks, no RVO */
+	MLOD_Reduced,
+	/** unseen and far away: no path at all, the agent snaps to the goal after the time the trip would have taken */
+	MLOD_Simulated
+};
+
 UCLASS(MinimalAPI)
 class UAITask_AsyncMoveTo : public UAITask
 {
@@ -50,6 +65,26 @@ public:
 	/** Switch task into continuous tracking mode: keep restarting move toward goal actor. Only pathfinding failure or external cancel will be able to stop this task. */
 	SHONIISLAND_API void SetContinuousGoalTracking(bool bEnable);
 
+	/** Path by sampling a flow field shared with every other agent heading for the same goal instead of running a search of our own.
+	 *	Meant for crowds converging on one place, agents outside the field's reach fall back to a regular query. */
+	SHONIISLAND_API void SetUseFlowField(bool bEnable);
+
+	/** Start walking a cheap straight-line path (clipped to the navmesh, at most INTERIM_HORIZON long) while the real path is
+	 *	pending, then splice the real one in from wherever the agent has got to. OnMoveFinished only ever reports the real move. */
+	SHONIISLAND_API void SetUseInterimPath(bool bEnable);
+
+	/** Scale movement cost with the agent's significance, see EMoveLOD. Off by default, only agents registered with the significance manager are ever reduced or simulated. */
+	SHONIISLAND_API void SetUseMoveLOD(bool bEnable);
+
+	/** Post-process found paths before following them (see UShoniPathSmoother): string-pull, spread agents that
+	 *	share corners across lanes and round sharp turns. Paths found after the frame's smoothing budget is spent are followed as they are */
+	SHONIISLAND_API void SetUsePathSmoothing(bool bEnable);
+
+	EMoveLOD GetMoveLOD() const { return CurrentMoveLOD; }
+
+	/** moves started after the first, whether from goal tracking, invalidated paths or LOD changes */
+	int32 GetNumRepaths() const { return FMath::Max(NumPerformedMoves - 1, 0); }
+
 protected:
 
 	/** parameters of move request */
@@ -74,9 +109,156 @@ protected:
 	/** currently followed path */
 	FNavPathSharedPtr Path;
 
+	/** ticket of the path request queued on or dispatched by UShoniPathScheduler, 0 if none */
+	uint32 PathRequestTicket = 0;
+
+	/** id of the query handed straight to FindPathAsync when there is no scheduler */
+	uint32 InFlightQueryID = INVALID_NAVQUERYID;
+
+	/** query of the pending request, kept so its result can be added to the path cache */
+	FPathFindingQuery PendingPathQuery;
+
+	/** bumped by every PerformMove, results carrying an older generation are stale and dropped */
+	uint32 PathQueryGeneration = 0;
+
+	/** intermediate goals along the hierarchical corridor of a long move, the last being the real goal. Empty for regular moves */
+	TArray<FVector> CorridorWaypoints;
+
+	/** index of the waypoint currently being walked to, INDEX_NONE when not following a corridor */
+	int32 CorridorSegment = INDEX_NONE;
+
+	/** path to the waypoint after the current one, fetched while the current segment is walked */
+	FNavPathSharedPtr NextSegmentPath;
+
+	/** acceptance radius at intermediate waypoints, the agent carries straight on so it needn't be exact */
+	const float CORRIDOR_WAYPOINT_RADIUS = 150.f;
+
+	/** furthest an interim path reaches towards the goal */
+	const float INTERIM_HORIZON = 1500.f;
+
+	/** interim paths shorter than this aren't worth starting */
+	const float INTERIM_MIN_LENGTH = 100.f;
+
+	/** corners of the real path checked for visibility when splicing it in after an interim move */
+	const int32 INTERIM_SPLICE_LOOKAHEAD = 3;
+
+	/** goal tracking: repath once the goal has drifted this fraction of the distance to it, never less than the acceptance radius */
+	const float REPATH_DISTANCE_RATIO = .15f;
+
+	/** goal tracking: most seconds of goal velocity extrapolated, less as the agent closes in */
+	const float GOAL_PREDICTION_TIME = 1.f;
+
+	/** goal tracking: minimum seconds between full repaths of this agent */
+	const float MIN_REPATH_INTERVAL = .5f;
+
+	/** goal tracking: drifts under this are absorbed by moving the path's end instead of searching again */
+	const float END_CORRECTION_DISTANCE = 400.f;
+
+	/** goal tracking: the goal is checked every MIN_GOAL_CHECK_INTERVAL up close, easing out to MAX_GOAL_CHECK_INTERVAL at GOAL_CHECK_FAR_DISTANCE */
+	const float MIN_GOAL_CHECK_INTERVAL = .1f;
+	const float MAX_GOAL_CHECK_INTERVAL = 1.f;
+	const float GOAL_CHECK_FAR_DISTANCE = 5000.f;
+
+	/** world time of the last full search, for MIN_REPATH_INTERVAL */
+	double LastRepathTime = -1.0e10;
+
+	/** handle of the active CheckGoalMoved timer */
+	FTimerHandle GoalCheckTimerHandle;
+
+	/** movement LOD: significance at or above which the agent gets full fidelity */
+	const float FULL_LOD_SIGNIFICANCE = .3f;
+
+	/** movement LOD: insignificant agents are only simulated once unrendered for this long and this far from every player camera */
+	const float SIMULATE_UNSEEN_TIME = 2.f;
+	const float SIMULATE_MIN_CAMERA_DISTANCE = 5000.f;
+
+	/** movement LOD: path following tick interval at MLOD_Reduced */
+	const float REDUCED_PF_TICK_INTERVAL = .1f;
+
+	/** movement LOD: simulated trips take the straight line distance times this, to allow for the path not being straight */
+	const float SIMULATED_DETOUR_FACTOR = 1.3f;
+
+	/** movement LOD: seconds between significance checks while moving */
+	const float MOVE_LOD_CHECK_INTERVAL = 1.f;
+
+	EMoveLOD CurrentMoveLOD = MLOD_Full;
+
+	/** path following tick interval before MLOD_Reduced changed it, negative if untouched */
+	float DefaultPFTickInterval = -1.f;
+
+	/** simulated trip, see MLOD_Simulated */
+	FVector SimulatedStart = FVector::ZeroVector;
+	FVector SimulatedEnd = FVector::ZeroVector;
+	double SimulatedStartTime = 0.0;
+	float SimulatedDuration = 0.f;
+
+	/** handle of the simulated arrival timer */
+	FTimerHandle SimulatedArrivalHandle;
+
+	/** handle of the active CheckMoveLOD timer */
+	FTimerHandle MoveLODTimerHandle;
+
+	/** FPlatformTime the pending path was asked for, for UShoniPathStats */
+	double PathRequestTime = 0.0;
+
+	/** PerformMove calls over the task's lifetime */
+	int32 NumPerformedMoves = 0;
+
 	TEnumAsByte<EPathFollowingResult::Type> MoveResult;
 	uint8 bUseContinuousTracking : 1;
 
+	/** sample a shared flow field instead of searching, see SetUseFlowField */
+	uint8 bUseFlowField : 1;
+
+	/** set while this task holds a suppression on its agent's crowd steering */
+	uint8 bSuppressingCrowd : 1;
+
+	/** set while the pending query is for the next corridor segment rather than the one being walked */
+	uint8 bPrefetchingSegment : 1;
+
+	/** set when the agent reached its waypoint before the next segment's path came back */
+	uint8 bAwaitingSegment : 1;
+
+	/** set once a corridor segment failed to path, this task's later moves search flat */
+	uint8 bCorridorFailed : 1;
+
+	/** set while PerformMove replans the same move flat after a corridor failed, so it isn't counted as a repath */
+	uint8 bRetryingMove : 1;
+
+	/** walk an interim path while the real one is pending, see SetUseInterimPath */
+	uint8 bUseInterimPath : 1;
+
+	/** set from starting an interim move until the real path replaces it */
+	uint8 bFollowingInterim : 1;
+
+	/** pick a movement LOD from significance, see SetUseMoveLOD */
+	uint8 bUseMoveLOD : 1;
+
+	/** set while a trip is being simulated instead of walked */
+	uint8 bSimulatingMove : 1;
+
+	/** set while this task holds a suppression on its agent's crowd steering for being at reduced LOD */
+	uint8 bLODSuppressingCrowd : 1;
+
+	/** smooth paths before following them, see SetUsePathSmoothing */
+	uint8 bUsePathSmoothing : 1;
+
+	/** crowd component the suppression was taken on, released even if the controller has changed since */
+	TObjectKey<UCrowdFollowingComponent> SuppressedCrowdComp;
+
+	/** crowd component the reduced LOD suppression was taken on */
+	TObjectKey<UCrowdFollowingComponent> LODSuppressedCrowdComp;
+
+	/** number of suppressions held on each agent's crowd steering, across tasks */
+	static TMap<TObjectKey<UCrowdFollowingComponent>, int32> CrowdSuppressionCounts;
+
+	/** suspends RVO for this task's agent only while its path is pending. Reference counted per agent */
+	SHONIISLAND_API void SetCrowdSuppressed(bool bSuppress);
+
+	/** takes or releases one counted suppression on the agent's crowd steering, returns the component it was taken on */
+	TObjectKey<UCrowdFollowingComponent> AcquireCrowdSuppression() const;
+	static void ReleaseCrowdSuppression(const TObjectKey<UCrowdFollowingComponent>& CrowdComp);
+
 	SHONIISLAND_API virtual void Activate() override;
 	SHONIISLAND_API virtual void OnDestroy(bool bOwnerFinished) override;
 
@@ -101,7 +283,64 @@ protected:
 	/** start move request */
 	SHONIISLAND_API virtual void PerformMove();
 
-	void OnAsynPathResult(uint32 QueryID, ENavigationQueryResult::Type Result, FNavPathSharedPtr Path);
+	/** issues PendingPathQuery through the path cache, scheduler or straight to the navigation system */
+	SHONIISLAND_API void RequestPathQuery(bool bSuppressCrowd = true);
+
+	/** starts walking the current corridor segment along InPath and fetches the one after it */
+	void FollowCorridorSegment(FNavPathSharedPtr InPath);
+
+	/** called on reaching a waypoint, moves on to the next segment or waits for its path */
+	void AdvanceCorridor();
+
+	/** starts following a straight-line path towards PendingPathQuery's goal, if one is worth walking */
+	void StartInterimMove();
+
+	/** re-fits the start of InPath to the agent's current location after it has been walking an interim path */
+	void SpliceFromAgent(FNavPathSharedPtr InPath) const;
+
+	/** where the goal actor will be by the time the agent gets there, going by its current velocity */
+	FVector PredictGoalLocation() const;
+
+	/** goal tracking: queues the next CheckGoalMoved, sooner the closer the goal is */
+	void ScheduleGoalCheck();
+
+	/** goal tracking: corrects the path end, repaths or does nothing depending on how far the goal has drifted */
+	void CheckGoalMoved();
+
+	/** moves the end of the current path onto NewGoal, already projected with the path's filter, without a search, if it is visible from the last corner */
+	bool CorrectPathEnd(const FNavLocation& NewGoal);
+
+	/** two point path from PendingPathQuery's start to End, no corridor */
+	FNavPathSharedPtr MakeStraightPath(ARecastNavMesh& NavMesh, const FVector& End) const;
+
+	/** movement LOD the agent's significance and visibility call for right now */
+	EMoveLOD ComputeMoveLOD() const;
+
+	/** switches path following tick rate and RVO over to LOD */
+	void ApplyMoveLOD(EMoveLOD LOD);
+
+	/** movement LOD: re-evaluated every MOVE_LOD_CHECK_INTERVAL while the task runs */
+	void CheckMoveLOD();
+
+	/** stands the agent down and times the trip to the query's end instead of walking it */
+	void StartSimulatedMove(const FPathFindingQuery& NavQuery);
+	void OnSimulatedArrival();
+
+	/** puts the agent where the simulated trip would have got it and starts walking the rest for real */
+	void ResumeFromSimulation();
+
+	/** moves the pawn onto the navmesh at Location, keeping its height above the floor */
+	void SnapAgentTo(const FVector& Location) const;
+
+	void OnFlowFieldReady(TSharedPtr<const FShoniFlowField> Field, uint32 Generation);
+
+	/** cancels the pending path query, queued or in flight. Returns true if there was one */
+	SHONIISLAND_API bool AbortPathQuery();
+
+	void OnAsynPathResult(uint32 QueryID, ENavigationQueryResult::Type Result, FNavPathSharedPtr Path, uint32 Generation);
+
+	/** hands a found path to path following. ResultTime and bQueried are passed on to UShoniPathStats */
+	void FollowPath(FNavPathSharedPtr InPath, double ResultTime, bool bQueried);
 
 	/** event from followed path */
 	SHONIISLAND_API virtual void OnPathEvent(FNavigationPath* InPath, ENavPathEvent::Type Event);
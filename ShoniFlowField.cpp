@@ -0,0 +1,334 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShoniFlowField.h"
+#include "ShoniNavWorker.h"
+#include "NavigationSystem.h"
+#include "NavMesh/RecastNavMesh.h"
+#include "NavMesh/RecastQueryFilter.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogShoniFlowField, Log, All);
+
+namespace
+{
+	// twice the signed area of OAB, positive when B is counter-clockwise of A as seen from O
+	FORCEINLINE float Cross2D(const FVector& O, const FVector& A, const FVector& B)
+	{
+		return (A.X - O.X) * (B.Y - O.Y) - (A.Y - O.Y) * (B.X - O.X);
+	}
+
+	struct FOpenPoly
+	{
+		float Cost;
+		NavNodeRef Poly;
+		bool operator<(const FOpenPoly& Other) const { return Cost < Other.Cost; }
+	};
+}
+
+FNavPathSharedPtr FShoniFlowField::BuildPath(ARecastNavMesh& NavMesh, const FVector& Start, NavNodeRef StartPoly) const
+{
+	if (!Steps.Contains(StartPoly)) return nullptr;
+
+	// walk the field down to the goal collecting portals, oriented so Left is counter-clockwise of Right from the previous portal
+	struct FPortal { FVector Left; FVector Right; NavNodeRef Poly; };
+	TArray<FPortal, TInlineAllocator<64>> Portals;
+	TArray<NavNodeRef> Corridor;
+	Portals.Add({ Start, Start, StartPoly });
+	Corridor.Add(StartPoly);
+	FVector Prev = Start;
+	NavNodeRef Poly = StartPoly;
+	while (Poly != GoalPoly && Corridor.Num() <= Steps.Num())
+	{
+		const FPolyStep& Step = Steps.FindChecked(Poly);
+		const bool bAIsRight = Cross2D(Prev, Step.PortalA, Step.PortalB) > 0.f;
+		Portals.Add({ bAIsRight ? Step.PortalB : Step.PortalA, bAIsRight ? Step.PortalA : Step.PortalB, Step.Next });
+		Prev = (Step.PortalA + Step.PortalB) * .5f;
+		Poly = Step.Next;
+		Corridor.Add(Poly);
+	}
+	Portals.Add({ Goal, Goal, GoalPoly });
+
+	// simple stupid funnel
+	TSharedPtr<FNavMeshPath> NewPath = MakeShared<FNavMeshPath>();
+	TArray<FNavPathPoint>& Points = NewPath->GetPathPoints();
+	Points.Add(FNavPathPoint(Start, StartPoly));
+	FVector Apex = Start, FunnelLeft = Start, FunnelRight = Start;
+	int32 ApexIdx = 0, LeftIdx = 0, RightIdx = 0;
+	for (int32 i = 1; i < Portals.Num(); ++i)
+	{
+		const FPortal& Portal = Portals[i];
+		// tighten the right side
+		if (Cross2D(Apex, FunnelRight, Portal.Right) >= 0.f)
+		{
+			if (Apex.Equals(FunnelRight) || Cross2D(Apex, FunnelLeft, Portal.Right) <= 0.f)
+			{
+				FunnelRight = Portal.Right;
+				RightIdx = i;
+			}
+			else
+			{
+				// crossed over the left side, which becomes a corner
+				Apex = FunnelLeft;
+				ApexIdx = LeftIdx;
+				Points.Add(FNavPathPoint(Apex, Portals[ApexIdx].Poly));
+				FunnelLeft = FunnelRight = Apex;
+				LeftIdx = RightIdx = ApexIdx;
+				i = ApexIdx;
+				continue;
+			}
+		}
+		// tighten the left side
+		if (Cross2D(Apex, FunnelLeft, Portal.Left) <= 0.f)
+		{
+			if (Apex.Equals(FunnelLeft) || Cross2D(Apex, FunnelRight, Portal.Left) >= 0.f)
+			{
+				FunnelLeft = Portal.Left;
+				LeftIdx = i;
+			}
+			else
+			{
+				Apex = FunnelRight;
+				ApexIdx = RightIdx;
+				Points.Add(FNavPathPoint(Apex, Portals[ApexIdx].Poly));
+				FunnelLeft = FunnelRight = Apex;
+				LeftIdx = RightIdx = ApexIdx;
+				i = ApexIdx;
+				continue;
+			}
+		}
+	}
+	if (!Points.Last().Location.Equals(Goal)) Points.Add(FNavPathPoint(Goal, GoalPoly));
+
+	NewPath->PathCorridor = MoveTemp(Corridor);
+	NewPath->SetNavigationDataUsed(&NavMesh);
+	NewPath->SetTimeStamp(NavMesh.GetWorldTimeStamp());
+	NewPath->MarkReady();
+	return NewPath;
+}
+
+UShoniFlowFieldManager* UShoniFlowFieldManager::Get(const UWorld* World)
+{
+	return World ? World->GetSubsystem<UShoniFlowFieldManager>() : nullptr;
+}
+
+bool UShoniFlowFieldManager::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld() && Super::ShouldCreateSubsystem(Outer);
+}
+
+void UShoniFlowFieldManager::Deinitialize()
+{
+	if (UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()))
+	{
+		NavSys->OnNavigationGenerationFinishedDelegate.Remove(NavGeneratedHandle);
+	}
+	Fields.Reset();
+	Super::Deinitialize();
+}
+
+TSharedPtr<const FShoniFlowField> UShoniFlowFieldManager::RequestField(const FPathFindingQuery& Query, TSubclassOf<UNavigationQueryFilter> FilterClass, const FOnShoniFlowFieldReady& OnReady)
+{
+	check(IsInGameThread());
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	ARecastNavMesh* NavMesh = NavSys ? Cast<ARecastNavMesh>(NavSys->GetNavDataForProps(Query.NavAgentProperties)) : nullptr;
+	if (!NavMesh) return nullptr;
+	// navmesh rebuilds invalidate every field, bound lazily since the nav system comes up after subsystems
+	if (!NavGeneratedHandle.IsValid())
+	{
+		NavGeneratedHandle = NavSys->OnNavigationGenerationFinishedDelegate.AddUObject(this, &UShoniFlowFieldManager::OnNavigationGenerated);
+	}
+
+	const double Now = GetWorld()->GetTimeSeconds();
+	// drop fields nobody has asked for in a while
+	Fields.RemoveAllSwap([this, Now](const FFieldEntry& Entry) { return Entry.bReady && Now - Entry.LastUsedTime > FIELD_LIFETIME; }, false);
+
+	for (FFieldEntry& Entry : Fields)
+	{
+		if (Entry.Field->FilterClass != FilterClass.Get() || !Entry.Field->Goal.Equals(Query.EndLocation, GOAL_TOLERANCE)) continue;
+		Entry.LastUsedTime = Now;
+		if (Entry.bReady) return Entry.Field;
+		Entry.Waiters.Add(OnReady);
+		return nullptr;
+	}
+
+	FFieldEntry& Entry = Fields.AddDefaulted_GetRef();
+	Entry.Field = MakeShared<FShoniFlowField>();
+	Entry.Field->Goal = Query.EndLocation;
+	Entry.Field->FilterClass = FilterClass.Get();
+	Entry.Field->GoalPoly = NavMesh->FindNearestPoly(Query.EndLocation, NavMesh->GetDefaultQueryExtent(), Query.QueryFilter);
+	Entry.LastUsedTime = Now;
+	if (Entry.Field->GoalPoly == INVALID_NAVNODEREF)
+	{
+		Fields.Pop(false);
+		OnReady.ExecuteIfBound(nullptr);
+		return nullptr;
+	}
+	Entry.Waiters.Add(OnReady);
+	StartBuild(Entry, NavMesh, Query.QueryFilter);
+	return nullptr;
+}
+
+FNavPathSharedPtr UShoniFlowFieldManager::BuildPath(const FShoniFlowField& Field, const FPathFindingQuery& Query) const
+{
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	ARecastNavMesh* NavMesh = NavSys ? Cast<ARecastNavMesh>(NavSys->GetNavDataForProps(Query.NavAgentProperties)) : nullptr;
+	if (!NavMesh) return nullptr;
+
+	const NavNodeRef StartPoly = NavMesh->FindNearestPoly(Query.StartLocation, NavMesh->GetDefaultQueryExtent(), Query.QueryFilter);
+	// the field ends at the first requester's goal, this agent's own has to be on it too
+	FNavLocation AgentGoal;
+	if (!NavMesh->ProjectPoint(Query.EndLocation, AgentGoal, NavMesh->GetDefaultQueryExtent(), Query.QueryFilter)
+		|| (AgentGoal.NodeRef != Field.GoalPoly && !Field.Covers(AgentGoal.NodeRef)))
+	{
+		return nullptr;
+	}
+	FNavPathSharedPtr NewPath = Field.BuildPath(*NavMesh, Query.StartLocation, StartPoly);
+	if (!NewPath.IsValid()) return nullptr;
+
+	TArray<FNavPathPoint>& Points = NewPath->GetPathPoints();
+	if (!Points.Last().Location.Equals(AgentGoal.Location))
+	{
+		// swap the field's goal for ours if the last corner can walk straight to it, otherwise path normally
+		FVector HitLocation;
+		const FVector& LastCorner = Points.Num() > 1 ? Points[Points.Num() - 2].Location : Points.Last().Location;
+		if (NavMesh->Raycast(LastCorner, AgentGoal.Location, HitLocation, Query.QueryFilter)) return nullptr;
+		if (Points.Num() > 1)
+		{
+			Points.Pop(false);
+		}
+		Points.Add(FNavPathPoint(AgentGoal.Location, AgentGoal.NodeRef));
+		TArray<NavNodeRef>& Corridor = NewPath->CastPath<FNavMeshPath>()->PathCorridor;
+		const int32 GoalIndex = Corridor.Find(AgentGoal.NodeRef);
+		if (GoalIndex != INDEX_NONE)
+		{
+			Corridor.SetNum(GoalIndex + 1, false);
+		}
+		else
+		{
+			Corridor.Add(AgentGoal.NodeRef);
+		}
+	}
+	NewPath->SetQuerier(Query.Owner.Get());
+	NewPath->SetFilter(Query.QueryFilter);
+	return NewPath;
+}
+
+void UShoniFlowFieldManager::StartBuild(FFieldEntry& Entry, ARecastNavMesh* NavMesh, FSharedConstNavQueryFilter QueryFilter)
+{
+	Entry.bReady = false;
+	Entry.bRebuild = false;
+	Entry.Field->Steps.Reset();
+	UShoniNavWorker* Worker = UShoniNavWorker::Get(GetWorld());
+	if (!Worker) return;
+	TSharedPtr<FShoniFlowField> Field = Entry.Field;
+	TWeakObjectPtr<ARecastNavMesh> WeakNavMesh = NavMesh;
+	TWeakObjectPtr<UShoniFlowFieldManager> WeakThis = this;
+	const float Radius = FIELD_RADIUS;
+	const int32 MaxPolys = MAX_FIELD_POLYS;
+	Worker->Launch(*NavMesh, [Field, QueryFilter, Radius, MaxPolys](const ARecastNavMesh& Mesh, const std::atomic<bool>& bCancelled)
+		{
+			BuildField(*Field, Mesh, QueryFilter, Radius, MaxPolys, bCancelled);
+		},
+		[Field, WeakNavMesh, WeakThis, QueryFilter](bool bCompleted)
+		{
+			if (UShoniFlowFieldManager* Manager = WeakThis.Get())
+			{
+				Manager->OnFieldBuilt(Field, bCompleted ? WeakNavMesh : nullptr, QueryFilter);
+			}
+		});
+}
+
+void UShoniFlowFieldManager::BuildField(FShoniFlowField& Field, const ARecastNavMesh& NavMesh, const FSharedConstNavQueryFilter& QueryFilter, float Radius, int32 MaxPolys, const std::atomic<bool>& bCancelled)
+{
+	const FRecastQueryFilter* Filter = QueryFilter.IsValid() ? static_cast<const FRecastQueryFilter*>(QueryFilter->GetImplementation()) : nullptr;
+	// point each poly was entered at, distances are measured between entry points
+	TMap<NavNodeRef, FVector> EntryPoints;
+	TArray<FOpenPoly> Open;
+	TArray<FNavigationPortalEdge> Edges;
+
+	Field.Steps.Add(Field.GoalPoly, FShoniFlowField::FPolyStep());
+	EntryPoints.Add(Field.GoalPoly, Field.Goal);
+	Open.HeapPush({ 0.f, Field.GoalPoly });
+	while (Open.Num() && Field.Steps.Num() < MaxPolys && !bCancelled)
+	{
+		FOpenPoly Current;
+		Open.HeapPop(Current, false);
+		if (Current.Cost > Field.Steps.FindChecked(Current.Poly).Cost) continue;
+
+		const FVector From = EntryPoints.FindChecked(Current.Poly);
+		Edges.Reset();
+		NavMesh.GetPolyNeighbors(Current.Poly, Edges);
+		for (const FNavigationPortalEdge& Edge : Edges)
+		{
+			const FVector Mid = (Edge.Left + Edge.Right) * .5f;
+			if (FVector::DistSquared(Mid, Field.Goal) > FMath::Square(Radius)) continue;
+
+			float AreaCost = 1.f;
+			if (Filter)
+			{
+				uint16 PolyFlags = 0, AreaFlags = 0;
+				uint8 AreaID = 0;
+				NavMesh.GetPolyFlags(Edge.ToRef, PolyFlags, AreaFlags);
+				if (!(PolyFlags & Filter->getIncludeFlags()) || (PolyFlags & Filter->getExcludeFlags())) continue;
+				if (NavMesh.GetPolyAreaID(Edge.ToRef, AreaID)) AreaCost = Filter->getAreaCost(AreaID);
+			}
+			const float NewCost = Current.Cost + FVector::Dist(From, Mid) * AreaCost;
+			FShoniFlowField::FPolyStep* Existing = Field.Steps.Find(Edge.ToRef);
+			if (Existing && Existing->Cost <= NewCost) continue;
+
+			FShoniFlowField::FPolyStep& Step = Existing ? *Existing : Field.Steps.Add(Edge.ToRef);
+			Step.Next = Current.Poly;
+			Step.Cost = NewCost;
+			Step.PortalA = Edge.Left;
+			Step.PortalB = Edge.Right;
+			EntryPoints.Add(Edge.ToRef, Mid);
+			Open.HeapPush({ NewCost, Edge.ToRef });
+		}
+	}
+}
+
+void UShoniFlowFieldManager::OnFieldBuilt(TSharedPtr<FShoniFlowField> Field, TWeakObjectPtr<ARecastNavMesh> NavMesh, FSharedConstNavQueryFilter QueryFilter)
+{
+	const int32 EntryIndex = Fields.IndexOfByPredicate([&Field](const FFieldEntry& Candidate) { return Candidate.Field == Field; });
+	if (EntryIndex == INDEX_NONE) return;
+	FFieldEntry* Entry = &Fields[EntryIndex];
+	if (!NavMesh.IsValid())
+	{
+		// navmesh went or the build was cancelled, waiters path normally
+		TArray<FOnShoniFlowFieldReady> Waiters = MoveTemp(Entry->Waiters);
+		Fields.RemoveAtSwap(EntryIndex, 1, false);
+		for (const FOnShoniFlowFieldReady& Waiter : Waiters)
+		{
+			Waiter.ExecuteIfBound(nullptr);
+		}
+		return;
+	}
+	if (Entry->bRebuild)
+	{
+		StartBuild(*Entry, NavMesh.Get(), QueryFilter);
+		return;
+	}
+	Entry->bReady = true;
+	UE_LOG(LogShoniFlowField, Verbose, TEXT("Flow field to %s built over %i polys for %i agents"), *Field->Goal.ToString(), Field->Steps.Num(), Entry->Waiters.Num());
+
+	// waiters may request again from their callback
+	TArray<FOnShoniFlowFieldReady> Waiters = MoveTemp(Entry->Waiters);
+	for (const FOnShoniFlowFieldReady& Waiter : Waiters)
+	{
+		Waiter.ExecuteIfBound(Field);
+	}
+}
+
+void UShoniFlowFieldManager::InvalidateAll()
+{
+	Fields.RemoveAllSwap([](const FFieldEntry& Entry) { return Entry.bReady; }, false);
+	for (FFieldEntry& Entry : Fields)
+	{
+		Entry.bRebuild = true;
+	}
+}
+
+void UShoniFlowFieldManager::OnNavigationGenerated(ANavigationData* NavData)
+{
+	InvalidateAll();
+}
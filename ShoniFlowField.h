@@ -0,0 +1,89 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "NavigationData.h"
+#include "NavFilters/NavigationQueryFilter.h"
+#include <atomic>
+#include "ShoniFlowField.generated.h"
+
+class ARecastNavMesh;
+struct FShoniFlowField;
+
+DECLARE_DELEGATE_OneParam(FOnShoniFlowFieldReady, TSharedPtr<const FShoniFlowField>);
+
+/* Integration field over navmesh polys towards a single goal. Built once on a worker and read-only from then on */
+struct SHONIISLAND_API FShoniFlowField
+{
+	struct FPolyStep
+	{
+		// one poly closer to the goal, INVALID_NAVNODEREF at the goal poly
+		NavNodeRef Next = INVALID_NAVNODEREF;
+		float Cost = 0.f;
+		// portal into Next, unordered
+		FVector PortalA = FVector::ZeroVector;
+		FVector PortalB = FVector::ZeroVector;
+	};
+
+	FVector Goal = FVector::ZeroVector;
+	NavNodeRef GoalPoly = INVALID_NAVNODEREF;
+	const UClass* FilterClass = nullptr;
+	TMap<NavNodeRef, FPolyStep> Steps;
+
+	bool Covers(NavNodeRef Poly) const { return Steps.Contains(Poly); }
+	/* Game thread only. Follows the field down from the start poly and funnels the portals into a navmesh path. Null if the poly isn't covered */
+	FNavPathSharedPtr BuildPath(ARecastNavMesh& NavMesh, const FVector& Start, NavNodeRef StartPoly) const;
+};
+
+/* Shares one flow field between every agent heading for the same goal (within GOAL_TOLERANCE), so a crowd converging
+ * on one place pays for a single search instead of one per agent */
+UCLASS()
+class SHONIISLAND_API UShoniFlowFieldManager : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UShoniFlowFieldManager* Get(const UWorld* World);
+
+	/* Game thread only. Returns the field if it is already built, otherwise null and OnReady fires once it is.
+	 * OnReady gets null, possibly before this returns, if no field can be built towards the goal */
+	TSharedPtr<const FShoniFlowField> RequestField(const FPathFindingQuery& Query, TSubclassOf<UNavigationQueryFilter> FilterClass, const FOnShoniFlowFieldReady& OnReady);
+	/* Game thread only. Path for the query's agent down a built field, ending at the query's own goal. Null if the agent or
+	 * its goal is outside the field, or the goal can't be reached in a straight line from the field's last corner */
+	FNavPathSharedPtr BuildPath(const FShoniFlowField& Field, const FPathFindingQuery& Query) const;
+	/* Drops every built field and rebuilds the ones still being waited on */
+	void InvalidateAll();
+	int32 GetNumFields() const { return Fields.Num(); }
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Deinitialize() override;
+
+private:
+	struct FFieldEntry
+	{
+		TSharedPtr<FShoniFlowField> Field;
+		TArray<FOnShoniFlowFieldReady> Waiters;
+		bool bReady = false;
+		// set if the navmesh changed while this was building
+		bool bRebuild = false;
+		double LastUsedTime = 0.0;
+	};
+	TArray<FFieldEntry> Fields;
+	FDelegateHandle NavGeneratedHandle;
+	// goals closer than this share a field
+	const float GOAL_TOLERANCE = 300.f;
+	// how far out from the goal a field reaches, agents outside it path normally
+	const float FIELD_RADIUS = 30000.f;
+	const int32 MAX_FIELD_POLYS = 20000;
+	// unused ready fields are dropped after this many seconds
+	const float FIELD_LIFETIME = 30.f;
+
+	void StartBuild(FFieldEntry& Entry, ARecastNavMesh* NavMesh, FSharedConstNavQueryFilter QueryFilter);
+	void OnFieldBuilt(TSharedPtr<FShoniFlowField> Field, TWeakObjectPtr<ARecastNavMesh> NavMesh, FSharedConstNavQueryFilter QueryFilter);
+	void OnNavigationGenerated(ANavigationData* NavData);
+	/* Worker thread, run through UShoniNavWorker. Dijkstra outwards from the goal poly across portal midpoints, respecting the
+	 * filter's include/exclude flags and area costs. Stops early, leaving a partial field, once bCancelled is set */
+	static void BuildField(FShoniFlowField& Field, const ARecastNavMesh& NavMesh, const FSharedConstNavQueryFilter& QueryFilter, float Radius, int32 MaxPolys, const std::atomic<bool>& bCancelled);
+};
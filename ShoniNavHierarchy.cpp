@@ -0,0 +1,370 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShoniNavHierarchy.h"
+#include "ShoniNavWorker.h"
+#include "NavigationSystem.h"
+#include "NavMesh/RecastNavMesh.h"
+#include "Detour/DetourNavMesh.h"
+#include "Algo/Reverse.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogShoniNavHierarchy, Log, All);
+
+namespace
+{
+	struct FOpenRegion
+	{
+		// cost so far plus straight line to the goal
+		float Estimate;
+		float Cost;
+		int32 Region;
+		bool operator<(const FOpenRegion& Other) const { return Estimate < Other.Estimate; }
+	};
+
+	struct FRegionVisit
+	{
+		int32 From;
+		float Cost;
+		// portal the region was entered through
+		FVector Entry;
+	};
+}
+
+UShoniNavHierarchy* UShoniNavHierarchy::Get(const UWorld* World)
+{
+	return World ? World->GetSubsystem<UShoniNavHierarchy>() : nullptr;
+}
+
+bool UShoniNavHierarchy::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld() && Super::ShouldCreateSubsystem(Outer);
+}
+
+void UShoniNavHierarchy::Deinitialize()
+{
+	if (UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()))
+	{
+		NavSys->OnNavigationGenerationFinishedDelegate.Remove(NavGeneratedHandle);
+	}
+	Reset();
+	Super::Deinitialize();
+}
+
+void UShoniNavHierarchy::Reset()
+{
+	Regions.Reset();
+	FreeRegions.Reset();
+	PolyRegions.Reset();
+	TileRegions.Reset();
+	TileSentinels.Reset();
+	BuiltNavMesh.Reset();
+	BuiltTileCount = 0;
+	bBuilt = false;
+}
+
+bool UShoniNavHierarchy::FindCorridor(const FPathFindingQuery& Query, TArray<FVector>& OutWaypoints)
+{
+	check(IsInGameThread());
+	OutWaypoints.Reset();
+	if (FVector::Dist2D(Query.StartLocation, Query.EndLocation) < LONG_MOVE_DISTANCE) return false;
+
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	ARecastNavMesh* NavMesh = NavSys ? Cast<ARecastNavMesh>(NavSys->GetNavDataForProps(Query.NavAgentProperties)) : nullptr;
+	if (!NavMesh) return false;
+	// bound lazily since the nav system comes up after subsystems
+	if (!NavGeneratedHandle.IsValid())
+	{
+		NavGeneratedHandle = NavSys->OnNavigationGenerationFinishedDelegate.AddUObject(this, &UShoniNavHierarchy::OnNavigationGenerated);
+	}
+	if (!bBuilt || BuiltNavMesh.Get() != NavMesh)
+	{
+		// long moves take flat searches until the graph is ready
+		if (!bBuilding)
+		{
+			Reset();
+			StartBuild(NavMesh);
+		}
+		return false;
+	}
+	RebuildDirtyTiles(*NavMesh);
+
+	const FVector Extent = NavMesh->GetDefaultQueryExtent();
+	const int32* StartRegion = PolyRegions.Find(NavMesh->FindNearestPoly(Query.StartLocation, Extent, Query.QueryFilter));
+	const int32* GoalRegion = PolyRegions.Find(NavMesh->FindNearestPoly(Query.EndLocation, Extent, Query.QueryFilter));
+	if (!StartRegion || !GoalRegion || *StartRegion == *GoalRegion) return false;
+
+	// A* over regions, costs measured between the portals each region is entered through
+	const FVector GoalCenter = Regions[*GoalRegion].Center;
+	TMap<int32, FRegionVisit> Visited;
+	TArray<FOpenRegion> Open;
+	Visited.Add(*StartRegion, { INDEX_NONE, 0.f, Query.StartLocation });
+	Open.HeapPush({ FVector::Dist(Query.StartLocation, GoalCenter), 0.f, *StartRegion });
+	while (Open.Num())
+	{
+		FOpenRegion Current;
+		Open.HeapPop(Current, false);
+		if (Current.Region == *GoalRegion) break;
+		const FRegionVisit Visit = Visited.FindChecked(Current.Region);
+		// superseded by a cheaper route
+		if (Current.Cost > Visit.Cost) continue;
+
+		for (const TPair<int32, FVector>& Portal : Regions[Current.Region].Portals)
+		{
+			const float NewCost = Visit.Cost + FVector::Dist(Visit.Entry, Portal.Value);
+			const FRegionVisit* Existing = Visited.Find(Portal.Key);
+			if (Existing && Existing->Cost <= NewCost) continue;
+			Visited.Add(Portal.Key, { Current.Region, NewCost, Portal.Value });
+			Open.HeapPush({ NewCost + FVector::Dist(Portal.Value, GoalCenter), NewCost, Portal.Key });
+		}
+	}
+	if (!Visited.Contains(*GoalRegion)) return false;
+
+	TArray<int32> RegionPath;
+	for (int32 Region = *GoalRegion; Region != INDEX_NONE; Region = Visited.FindChecked(Region).From)
+	{
+		RegionPath.Add(Region);
+	}
+	Algo::Reverse(RegionPath);
+	// a waypoint every few regions at the portal leading into it, short enough for a cheap fine search each
+	for (int32 i = SEGMENT_REGIONS; i < RegionPath.Num() - 1; i += SEGMENT_REGIONS)
+	{
+		OutWaypoints.Add(Visited.FindChecked(RegionPath[i]).Entry);
+	}
+	if (!OutWaypoints.Num()) return false;
+	OutWaypoints.Add(Query.EndLocation);
+	UE_LOG(LogShoniNavHierarchy, Verbose, TEXT("Corridor of %i regions split into %i segments, %i regions expanded"), RegionPath.Num(), OutWaypoints.Num(), Visited.Num());
+	return true;
+}
+
+void UShoniNavHierarchy::StartBuild(ARecastNavMesh* NavMesh)
+{
+	UShoniNavWorker* Worker = UShoniNavWorker::Get(GetWorld());
+	if (!Worker) return;
+	bBuilding = true;
+	bRebuild = false;
+	TSharedPtr<FBuildResult> Result = MakeShared<FBuildResult>();
+	TWeakObjectPtr<ARecastNavMesh> WeakNavMesh = NavMesh;
+	TWeakObjectPtr<UShoniNavHierarchy> WeakThis = this;
+	Worker->Launch(*NavMesh, [Result](const ARecastNavMesh& Mesh, const std::atomic<bool>& bCancelled)
+		{
+			const dtNavMesh* DetourMesh = Mesh.GetRecastMesh();
+			const int32 MaxTiles = DetourMesh ? DetourMesh->getMaxTiles() : 0;
+			TArray<int32> FreeList;
+			for (int32 TileIndex = 0; TileIndex < MaxTiles && !bCancelled; ++TileIndex)
+			{
+				TArray<int32> NewRegions;
+				BuildTileRegions(Mesh, TileIndex, Result->Regions, Result->PolyRegions, FreeList, NewRegions);
+				if (NewRegions.Num()) Result->TileRegions.Add(TileIndex, MoveTemp(NewRegions));
+			}
+		},
+		[Result, WeakNavMesh, WeakThis](bool bCompleted)
+		{
+			if (UShoniNavHierarchy* Hierarchy = WeakThis.Get())
+			{
+				Hierarchy->OnBuildFinished(Result, bCompleted ? WeakNavMesh : nullptr);
+			}
+		});
+}
+
+void UShoniNavHierarchy::OnBuildFinished(TSharedPtr<FBuildResult> Result, TWeakObjectPtr<ARecastNavMesh> NavMesh)
+{
+	bBuilding = false;
+	ARecastNavMesh* NavMeshPtr = NavMesh.Get();
+	if (!NavMeshPtr) return;
+	if (bRebuild)
+	{
+		StartBuild(NavMeshPtr);
+		return;
+	}
+
+	Regions = MoveTemp(Result->Regions);
+	PolyRegions = MoveTemp(Result->PolyRegions);
+	TileRegions = MoveTemp(Result->TileRegions);
+	for (const TPair<int32, TArray<int32>>& Pair : TileRegions)
+	{
+		RegisterSentinel(*NavMeshPtr, Pair.Key);
+	}
+	BuiltNavMesh = NavMesh;
+	BuiltTileCount = NavMeshPtr->GetNavMeshTilesCount();
+	bBuilt = true;
+	UE_LOG(LogShoniNavHierarchy, Log, TEXT("Navigation hierarchy built with %i regions over %i tiles"), Regions.Num(), TileRegions.Num());
+}
+
+void UShoniNavHierarchy::BuildTileRegions(const ARecastNavMesh& NavMesh, int32 TileIndex, TArray<FShoniNavRegion>& OutRegions, TMap<NavNodeRef, int32>& OutPolyRegions,
+	TArray<int32>& FreeList, TArray<int32>& OutTileRegions)
+{
+	TArray<FNavPoly> Polys;
+	if (!NavMesh.GetPolysInTile(TileIndex, Polys) || !Polys.Num()) return;
+
+	// union the tile's polys into connected islands
+	TMap<NavNodeRef, int32> LocalIndices;
+	LocalIndices.Reserve(Polys.Num());
+	for (int32 i = 0; i < Polys.Num(); ++i)
+	{
+		LocalIndices.Add(Polys[i].Ref, i);
+	}
+	TArray<int32> Parents;
+	Parents.SetNumUninitialized(Polys.Num());
+	for (int32 i = 0; i < Polys.Num(); ++i)
+	{
+		Parents[i] = i;
+	}
+	auto FindRoot = [&Parents](int32 i)
+	{
+		while (Parents[i] != i)
+		{
+			Parents[i] = Parents[Parents[i]];
+			i = Parents[i];
+		}
+		return i;
+	};
+	TArray<TArray<FNavigationPortalEdge>> Edges;
+	Edges.SetNum(Polys.Num());
+	for (int32 i = 0; i < Polys.Num(); ++i)
+	{
+		NavMesh.GetPolyNeighbors(Polys[i].Ref, Edges[i]);
+		for (const FNavigationPortalEdge& Edge : Edges[i])
+		{
+			if (const int32* Other = LocalIndices.Find(Edge.ToRef))
+			{
+				Parents[FindRoot(i)] = FindRoot(*Other);
+			}
+		}
+	}
+
+	// one region per island
+	TMap<int32, int32> RootRegions;
+	TArray<int32> PolyRegionIndices;
+	PolyRegionIndices.SetNumUninitialized(Polys.Num());
+	for (int32 i = 0; i < Polys.Num(); ++i)
+	{
+		const int32 Root = FindRoot(i);
+		int32* RegionIdx = RootRegions.Find(Root);
+		if (!RegionIdx)
+		{
+			const int32 NewIdx = FreeList.Num() ? FreeList.Pop(false) : OutRegions.AddDefaulted();
+			OutRegions[NewIdx] = FShoniNavRegion();
+			OutRegions[NewIdx].TileIndex = TileIndex;
+			OutRegions[NewIdx].bValid = true;
+			OutTileRegions.Add(NewIdx);
+			RegionIdx = &RootRegions.Add(Root, NewIdx);
+		}
+		FShoniNavRegion& Region = OutRegions[*RegionIdx];
+		Region.Polys.Add(Polys[i].Ref);
+		Region.Center += Polys[i].Center;
+		OutPolyRegions.Add(Polys[i].Ref, *RegionIdx);
+		PolyRegionIndices[i] = *RegionIdx;
+	}
+	// snap each center to its nearest poly center so it stays on the navmesh
+	for (const int32 RegionIdx : OutTileRegions)
+	{
+		FShoniNavRegion& Region = OutRegions[RegionIdx];
+		const FVector Average = Region.Center / Region.Polys.Num();
+		float BestDistSq = MAX_flt;
+		for (const NavNodeRef Poly : Region.Polys)
+		{
+			const FVector& PolyCenter = Polys[LocalIndices.FindChecked(Poly)].Center;
+			const float DistSq = FVector::DistSquared(PolyCenter, Average);
+			if (DistSq < BestDistSq)
+			{
+				BestDistSq = DistSq;
+				Region.Center = PolyCenter;
+			}
+		}
+	}
+
+	// portals to neighbouring tiles, the tile processed second links both sides
+	for (int32 i = 0; i < Polys.Num(); ++i)
+	{
+		const int32 Mine = PolyRegionIndices[i];
+		for (const FNavigationPortalEdge& Edge : Edges[i])
+		{
+			if (LocalIndices.Contains(Edge.ToRef)) continue;
+			const int32* Theirs = OutPolyRegions.Find(Edge.ToRef);
+			if (!Theirs || OutRegions[Mine].Portals.Contains(*Theirs)) continue;
+			const FVector Mid = (Edge.Left + Edge.Right) * .5f;
+			OutRegions[Mine].Portals.Add(*Theirs, Mid);
+			OutRegions[*Theirs].Portals.Add(Mine, Mid);
+		}
+	}
+}
+
+void UShoniNavHierarchy::RebuildDirtyTiles(ARecastNavMesh& NavMesh)
+{
+	// the navmesh invalidates a sentinel when its tile is rebuilt
+	TArray<int32> DirtyTiles;
+	for (const TPair<int32, FNavPathSharedPtr>& Pair : TileSentinels)
+	{
+		if (!Pair.Value->IsUpToDate()) DirtyTiles.Add(Pair.Key);
+	}
+	if (!DirtyTiles.Num()) return;
+
+	// clear every dirty tile before re-splitting any, so no portal links to a region about to go
+	for (const int32 TileIndex : DirtyTiles)
+	{
+		RemoveTile(TileIndex);
+	}
+	for (const int32 TileIndex : DirtyTiles)
+	{
+		TArray<int32> NewRegions;
+		BuildTileRegions(NavMesh, TileIndex, Regions, PolyRegions, FreeRegions, NewRegions);
+		if (!NewRegions.Num()) continue;
+		TileRegions.Add(TileIndex, MoveTemp(NewRegions));
+		RegisterSentinel(NavMesh, TileIndex);
+	}
+	UE_LOG(LogShoniNavHierarchy, Verbose, TEXT("Re-split %i rebuilt tiles, %i regions"), DirtyTiles.Num(), GetNumRegions());
+}
+
+void UShoniNavHierarchy::RemoveTile(int32 TileIndex)
+{
+	TArray<int32> OldRegions;
+	TileRegions.RemoveAndCopyValue(TileIndex, OldRegions);
+	TileSentinels.Remove(TileIndex);
+	for (const int32 RegionIdx : OldRegions)
+	{
+		FShoniNavRegion& Region = Regions[RegionIdx];
+		for (const TPair<int32, FVector>& Portal : Region.Portals)
+		{
+			Regions[Portal.Key].Portals.Remove(RegionIdx);
+		}
+		for (const NavNodeRef Poly : Region.Polys)
+		{
+			PolyRegions.Remove(Poly);
+		}
+		Region = FShoniNavRegion();
+		FreeRegions.Add(RegionIdx);
+	}
+}
+
+void UShoniNavHierarchy::RegisterSentinel(ARecastNavMesh& NavMesh, int32 TileIndex)
+{
+	const FShoniNavRegion& Region = Regions[TileRegions.FindChecked(TileIndex)[0]];
+	TSharedPtr<FNavMeshPath> Sentinel = MakeShared<FNavMeshPath>();
+	Sentinel->GetPathPoints().Add(FNavPathPoint(Region.Center, Region.Polys[0]));
+	Sentinel->PathCorridor.Add(Region.Polys[0]);
+	Sentinel->SetNavigationDataUsed(&NavMesh);
+	Sentinel->SetTimeStamp(NavMesh.GetWorldTimeStamp());
+	Sentinel->EnableRecalculationOnInvalidation(false);
+	Sentinel->MarkReady();
+	NavMesh.RegisterActivePath(Sentinel);
+	TileSentinels.Add(TileIndex, Sentinel);
+}
+
+void UShoniNavHierarchy::OnNavigationGenerated(ANavigationData* NavData)
+{
+	if (bBuilding)
+	{
+		bRebuild = true;
+		return;
+	}
+	// rebuilt tiles are caught by their sentinels, but tiles appearing where there were none need a full pass
+	const ARecastNavMesh* NavMesh = Cast<ARecastNavMesh>(NavData);
+	if (!bBuilt || !NavMesh || NavMesh != BuiltNavMesh.Get()) return;
+	const int32 TileCount = NavMesh->GetNavMeshTilesCount();
+	if (TileCount > BuiltTileCount)
+	{
+		Reset();
+		return;
+	}
+	BuiltTileCount = TileCount;
+}
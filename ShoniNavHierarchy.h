@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "NavigationData.h"
+#include "ShoniNavHierarchy.generated.h"
+
+class ARecastNavMesh;
+
+/* Connected polys of one navmesh tile, the nodes of the abstract graph */
+struct FShoniNavRegion
+{
+	int32 TileIndex = INDEX_NONE;
+	FVector Center = FVector::ZeroVector;
+	TArray<NavNodeRef> Polys;
+	// neighbouring region -> midpoint of one shared portal edge
+	TMap<int32, FVector> Portals;
+	bool bValid = false;
+};
+
+/* Abstract region/portal graph over the navmesh for long cross-island moves. The graph is built once on a worker when first
+ * needed and kept up to date tile by tile, a long move searches it first and then only runs short fine searches between
+ * waypoints along the resulting corridor */
+UCLASS()
+class SHONIISLAND_API UShoniNavHierarchy : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UShoniNavHierarchy* Get(const UWorld* World);
+
+	/* Game thread only. Fills OutWaypoints with intermediate goals roughly SEGMENT_REGIONS regions apart, the last being the query's end.
+	 * False if the graph isn't built yet, either end is off the navmesh, or the move is short enough for a flat search */
+	bool FindCorridor(const FPathFindingQuery& Query, TArray<FVector>& OutWaypoints);
+	bool IsBuilt() const { return bBuilt; }
+	int32 GetNumRegions() const { return Regions.Num() - FreeRegions.Num(); }
+
+	/* moves shorter than this always take a flat search */
+	const float LONG_MOVE_DISTANCE = 15000.f;
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Deinitialize() override;
+
+private:
+	TArray<FShoniNavRegion> Regions;
+	TArray<int32> FreeRegions;
+	TMap<NavNodeRef, int32> PolyRegions;
+	TMap<int32, TArray<int32>> TileRegions;
+	// one path per tile registered with the navmesh purely so a rebuild of that tile invalidates it
+	TMap<int32, FNavPathSharedPtr> TileSentinels;
+	TWeakObjectPtr<ARecastNavMesh> BuiltNavMesh;
+	int32 BuiltTileCount = 0;
+	FDelegateHandle NavGeneratedHandle;
+	bool bBuilt = false;
+	bool bBuilding = false;
+	// set if the navmesh changed while the graph was building
+	bool bRebuild = false;
+	// regions between consecutive waypoints
+	const int32 SEGMENT_REGIONS = 4;
+
+	struct FBuildResult
+	{
+		TArray<FShoniNavRegion> Regions;
+		TMap<NavNodeRef, int32> PolyRegions;
+		TMap<int32, TArray<int32>> TileRegions;
+	};
+	void StartBuild(ARecastNavMesh* NavMesh);
+	void OnBuildFinished(TSharedPtr<FBuildResult> Result, TWeakObjectPtr<ARecastNavMesh> NavMesh);
+	/* Any thread. Splits the tile's polys into connected regions, stored in free slots or appended to OutRegions, and links
+	 * portals to regions of neighbouring tiles that are already known */
+	static void BuildTileRegions(const ARecastNavMesh& NavMesh, int32 TileIndex, TArray<FShoniNavRegion>& OutRegions, TMap<NavNodeRef, int32>& OutPolyRegions,
+		TArray<int32>& FreeList, TArray<int32>& OutTileRegions);
+	/* Game thread only. Re-splits tiles the navmesh has rebuilt since the last query */
+	void RebuildDirtyTiles(ARecastNavMesh& NavMesh);
+	void RemoveTile(int32 TileIndex);
+	void RegisterSentinel(ARecastNavMesh& NavMesh, int32 TileIndex);
+	void OnNavigationGenerated(ANavigationData* NavData);
+	void Reset();
+};
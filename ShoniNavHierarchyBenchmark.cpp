@@ -0,0 +1,159 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShoniNavHierarchy.h"
+#include "NavigationSystem.h"
+#include "NavMesh/RecastNavMesh.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+#if !UE_BUILD_SHIPPING
+
+DEFINE_LOG_CATEGORY_STATIC(LogShoniNavHierarchyBenchmark, Log, All);
+
+/* Times hierarchical corridor searches against flat navmesh queries over the same random long-distance start/goal pairs.
+ * Everything runs synchronously on the game thread so the two are measured alike. Time to first segment is how long an
+ * agent waits before it can start walking, the total covers every segment of the corridor.
+ * Run with: Shoni.Nav.HierarchyBenchmark [Pairs] [Seed] [CsvPath] */
+struct FShoniNavHierarchyBenchmark
+{
+	static constexpr int32 MAX_PAIRS = 10000;
+	// random point draws per wanted pair before giving up on finding long enough ones
+	static constexpr int32 DRAWS_PER_PAIR = 20;
+
+	static double Now() { return FPlatformTime::Seconds() * 1000.0; }
+
+	static bool RandomNavPoint(UNavigationSystemV1& NavSys, const ARecastNavMesh& NavMesh, FRandomStream& Stream, FVector& OutLocation)
+	{
+		// the navmesh's own random points aren't seeded, draw inside its bounds from our stream instead
+		const FBox Bounds = NavMesh.GetNavMeshBounds();
+		const FVector Origin = Bounds.GetCenter() + FVector(Stream.FRandRange(-1.f, 1.f), Stream.FRandRange(-1.f, 1.f), 0.f) * Bounds.GetExtent();
+		FNavLocation Location;
+		if (!NavSys.ProjectPointToNavigation(Origin, Location, FVector(Bounds.GetExtent().X * .1f, Bounds.GetExtent().Y * .1f, Bounds.GetExtent().Z), &NavMesh))
+		{
+			return false;
+		}
+		OutLocation = Location.Location;
+		return true;
+	}
+
+	static void Run(const TArray<FString>& Args, UWorld* World)
+	{
+		const int32 NumPairs = FMath::Clamp(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 200, 1, MAX_PAIRS);
+		const int32 Seed = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 0;
+
+		UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World);
+		ARecastNavMesh* NavMesh = NavSys ? Cast<ARecastNavMesh>(NavSys->GetDefaultNavDataInstance()) : nullptr;
+		UShoniNavHierarchy* Hierarchy = UShoniNavHierarchy::Get(World);
+		if (!NavMesh || !Hierarchy)
+		{
+			UE_LOG(LogShoniNavHierarchyBenchmark, Warning, TEXT("Needs a game world with a recast navmesh"));
+			return;
+		}
+
+		// the same seed gives the same pairs, so runs before and after a change compare directly
+		FRandomStream Stream(Seed);
+		TArray<TPair<FVector, FVector>> Pairs;
+		FVector Start, End;
+		for (int32 Draw = 0; Draw < NumPairs * DRAWS_PER_PAIR && Pairs.Num() < NumPairs; ++Draw)
+		{
+			if (!RandomNavPoint(*NavSys, *NavMesh, Stream, Start) || !RandomNavPoint(*NavSys, *NavMesh, Stream, End)) continue;
+			if (FVector::Dist2D(Start, End) >= Hierarchy->LONG_MOVE_DISTANCE)
+			{
+				Pairs.Add(TPair<FVector, FVector>(Start, End));
+			}
+		}
+		if (!Pairs.Num())
+		{
+			UE_LOG(LogShoniNavHierarchyBenchmark, Warning, TEXT("No start/goal pairs at least %.0f apart on this navmesh"), Hierarchy->LONG_MOVE_DISTANCE);
+			return;
+		}
+
+		FSharedConstNavQueryFilter QueryFilter = NavMesh->GetDefaultQueryFilter();
+		TArray<FVector> Waypoints;
+		// the graph builds on a worker, the first long query only kicks it off
+		if (!Hierarchy->IsBuilt())
+		{
+			Hierarchy->FindCorridor(FPathFindingQuery(nullptr, *NavMesh, Pairs[0].Key, Pairs[0].Value, QueryFilter), Waypoints);
+			UE_LOG(LogShoniNavHierarchyBenchmark, Display, TEXT("Navigation hierarchy is building, run again once it has"));
+			return;
+		}
+
+		FString Csv = TEXT("Pair,Distance,FlatMs,FlatLength,FlatSuccess,CorridorMs,FirstSegmentMs,HierarchyMs,HierarchyLength,HierarchySuccess,Segments\n");
+		double FlatTotal = 0.0, FirstSegmentTotal = 0.0, HierarchyTotal = 0.0, FlatWorst = 0.0, FirstSegmentWorst = 0.0;
+		int32 NumBoth = 0, NumFlatFailed = 0, NumHierarchyFailed = 0;
+		for (int32 i = 0; i < Pairs.Num(); ++i)
+		{
+			const FVector& From = Pairs[i].Key;
+			const FVector& To = Pairs[i].Value;
+
+			double PhaseStart = Now();
+			const FPathFindingResult Flat = NavSys->FindPathSync(FPathFindingQuery(nullptr, *NavMesh, From, To, QueryFilter));
+			const double FlatMs = Now() - PhaseStart;
+
+			PhaseStart = Now();
+			const bool bCorridor = Hierarchy->FindCorridor(FPathFindingQuery(nullptr, *NavMesh, From, To, QueryFilter), Waypoints);
+			const double CorridorMs = Now() - PhaseStart;
+			double FirstSegmentMs = 0.0;
+			double HierarchyMs = CorridorMs;
+			float HierarchyLength = 0.f;
+			bool bHierarchySuccess = bCorridor;
+			if (bCorridor)
+			{
+				FVector SegmentStart = From;
+				for (int32 Segment = 0; Segment < Waypoints.Num(); ++Segment)
+				{
+					PhaseStart = Now();
+					const FPathFindingResult Fine = NavSys->FindPathSync(FPathFindingQuery(nullptr, *NavMesh, SegmentStart, Waypoints[Segment], QueryFilter));
+					HierarchyMs += Now() - PhaseStart;
+					if (Segment == 0)
+					{
+						FirstSegmentMs = HierarchyMs;
+					}
+					if (!Fine.IsSuccessful() || !Fine.Path.IsValid())
+					{
+						bHierarchySuccess = false;
+						break;
+					}
+					HierarchyLength += Fine.Path->GetLength();
+					SegmentStart = Waypoints[Segment];
+				}
+			}
+
+			// timings only compare over pairs both found, a failed search can be far cheaper or dearer than a found one
+			const bool bFlatSuccess = Flat.IsSuccessful() && Flat.Path.IsValid();
+			NumFlatFailed += !bFlatSuccess;
+			NumHierarchyFailed += !bHierarchySuccess;
+			if (bFlatSuccess && bHierarchySuccess)
+			{
+				++NumBoth;
+				FlatTotal += FlatMs;
+				FlatWorst = FMath::Max(FlatWorst, FlatMs);
+				FirstSegmentTotal += FirstSegmentMs;
+				FirstSegmentWorst = FMath::Max(FirstSegmentWorst, FirstSegmentMs);
+				HierarchyTotal += HierarchyMs;
+			}
+
+			Csv += FString::Printf(TEXT("%i,%.0f,%.4f,%.0f,%i,%.4f,%.4f,%.4f,%.0f,%i,%i\n"),
+				i, FVector::Dist(From, To), FlatMs, Flat.Path.IsValid() ? Flat.Path->GetLength() : 0.f, Flat.IsSuccessful() ? 1 : 0,
+				CorridorMs, FirstSegmentMs, HierarchyMs, HierarchyLength, bHierarchySuccess ? 1 : 0, bCorridor ? Waypoints.Num() : 0);
+		}
+
+		UE_LOG(LogShoniNavHierarchyBenchmark, Display, TEXT("%i pairs, %i regions, flat failed %i, hierarchy failed %i. Over the %i pairs both found: flat avg %.3fms, worst %.3fms. Hierarchy first segment avg %.3fms, worst %.3fms, full corridor avg %.3fms"),
+			Pairs.Num(), Hierarchy->GetNumRegions(), NumFlatFailed, NumHierarchyFailed, NumBoth,
+			NumBoth ? FlatTotal / NumBoth : 0.0, FlatWorst, NumBoth ? FirstSegmentTotal / NumBoth : 0.0, FirstSegmentWorst, NumBoth ? HierarchyTotal / NumBoth : 0.0);
+
+		const FString FilePath = Args.Num() > 2 ? Args[2] : FPaths::ProfilingDir() / TEXT("ShoniNavHierarchy") / FString::Printf(TEXT("Benchmark_%i_%s.csv"), Pairs.Num(), *FDateTime::Now().ToString());
+		if (FFileHelper::SaveStringToFile(Csv, *FilePath))
+		{
+			UE_LOG(LogShoniNavHierarchyBenchmark, Display, TEXT("Benchmark written to %s"), *FilePath);
+		}
+	}
+};
+
+static FAutoConsoleCommandWithWorldAndArgs ShoniNavHierarchyBenchmarkCommand(
+	TEXT("Shoni.Nav.HierarchyBenchmark"),
+	TEXT("Paths random long-distance start/goal pairs both flat and through the navigation hierarchy, and writes timings to CSV. Args: [Pairs] [Seed] [CsvPath]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&FShoniNavHierarchyBenchmark::Run));
+
+#endif
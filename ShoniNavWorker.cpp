@@ -0,0 +1,179 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShoniNavWorker.h"
+#include "NavigationSystem.h"
+#include "NavMesh/RecastNavMesh.h"
+#include "Async/Async.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogShoniNavWorker, Log, All);
+
+UShoniNavWorker* UShoniNavWorker::Get(const UWorld* World)
+{
+	return World ? World->GetSubsystem<UShoniNavWorker>() : nullptr;
+}
+
+bool UShoniNavWorker::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld() && Super::ShouldCreateSubsystem(Outer);
+}
+
+void UShoniNavWorker::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	LevelRemovedHandle = FWorldDelegates::PreLevelRemovedFromWorld.AddUObject(this, &UShoniNavWorker::OnPreLevelRemoved);
+	WorldCleanupHandle = FWorldDelegates::OnWorldCleanup.AddUObject(this, &UShoniNavWorker::OnWorldCleanup);
+}
+
+void UShoniNavWorker::Deinitialize()
+{
+	FWorldDelegates::PreLevelRemovedFromWorld.Remove(LevelRemovedHandle);
+	FWorldDelegates::OnWorldCleanup.Remove(WorldCleanupHandle);
+	CancelJobs(nullptr);
+	PendingJobs.Reset();
+	Super::Deinitialize();
+}
+
+TStatId UShoniNavWorker::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShoniNavWorker, STATGROUP_Tickables);
+}
+
+void UShoniNavWorker::Launch(ARecastNavMesh& NavMesh, FWork&& Work, FOnDone&& OnDone)
+{
+	check(IsInGameThread());
+	FJob& Job = PendingJobs.AddDefaulted_GetRef();
+	Job.NavMesh = &NavMesh;
+	Job.Work = MoveTemp(Work);
+	Job.OnDone = MoveTemp(OnDone);
+	Job.bCancelled = MakeShared<std::atomic<bool>>(false);
+}
+
+void UShoniNavWorker::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// finished jobs first so the build lock can come off this frame
+	for (int32 i = RunningJobs.Num() - 1; i >= 0; --i)
+	{
+		if (!RunningJobs[i].Future.IsReady()) continue;
+		FJob Job = MoveTemp(RunningJobs[i]);
+		RunningJobs.RemoveAtSwap(i, 1, false);
+		// may launch again, that only touches PendingJobs
+		Job.OnDone(Job.NavMesh.IsValid());
+	}
+
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	const double Now = FPlatformTime::Seconds();
+	const bool bDirty = NavSys && NavSys->HasDirtyAreasQueued();
+	DirtySince = !bDirty ? -1.0 : DirtySince < 0.0 ? Now : DirtySince;
+	if (bDirty && bHoldingBuildLock)
+	{
+		LongestRebuildWait = FMath::Max(LongestRebuildWait, float(Now - DirtySince));
+	}
+
+	// tiles only change on the game thread, so checking then locking here leaves no gap for a build to start in
+	bool bCanStart = PendingJobs.Num() && NavSys && !NavSys->IsNavigationBuildInProgress();
+	if (bHoldingBuildLock)
+	{
+		// stop feeding the lock so the running jobs drain and a queued rebuild gets its turn
+		bCanStart = bCanStart && !bDirty && Now - LockTime < MAX_LOCK_SECONDS;
+	}
+	else
+	{
+		// dirty areas that don't turn into a build (static navmesh) don't hold jobs up forever
+		bCanStart = bCanStart && (!bDirty || Now - UnlockTime > MAX_LOCK_SECONDS);
+	}
+	if (bCanStart)
+	{
+		SetBuildLocked(true);
+		TArray<FJob> Jobs = MoveTemp(PendingJobs);
+		for (FJob& Job : Jobs)
+		{
+			const ARecastNavMesh* NavMesh = Job.NavMesh.Get();
+			if (!NavMesh)
+			{
+				Job.OnDone(false);
+				continue;
+			}
+			TSharedPtr<std::atomic<bool>> bCancelled = Job.bCancelled;
+			Job.Future = Async(EAsyncExecution::TaskGraph, [NavMesh, Work = MoveTemp(Job.Work), bCancelled]()
+				{
+					Work(*NavMesh, *bCancelled);
+				});
+			RunningJobs.Add(MoveTemp(Job));
+		}
+	}
+	if (!RunningJobs.Num())
+	{
+		SetBuildLocked(false);
+	}
+}
+
+void UShoniNavWorker::SetBuildLocked(bool bLocked)
+{
+	if (bLocked == bHoldingBuildLock) return;
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	if (!NavSys)
+	{
+		bHoldingBuildLock = false;
+		return;
+	}
+	bHoldingBuildLock = bLocked;
+	const double Now = FPlatformTime::Seconds();
+	if (bLocked)
+	{
+		LockTime = Now;
+		NavSys->AddNavigationBuildLock(UNavigationSystemV1::ENavigationBuildLock::Custom);
+	}
+	else
+	{
+		UnlockTime = Now;
+		LongestBuildLock = FMath::Max(LongestBuildLock, float(Now - LockTime));
+		// dirty areas queued up meanwhile are still there, no need for a full rebuild
+		NavSys->RemoveNavigationBuildLock(UNavigationSystemV1::ENavigationBuildLock::Custom, UNavigationSystemV1::ELockRemovalRebuildAction::NoRebuild);
+	}
+}
+
+void UShoniNavWorker::CancelJobs(const ULevel* Level)
+{
+	TArray<FJob> Cancelled;
+	for (int32 i = RunningJobs.Num() - 1; i >= 0; --i)
+	{
+		FJob& Job = RunningJobs[i];
+		const ARecastNavMesh* NavMesh = Job.NavMesh.Get();
+		if (Level && NavMesh && NavMesh->GetLevel() != Level) continue;
+		*Job.bCancelled = true;
+		Job.Future.Wait();
+		Cancelled.Add(MoveTemp(Job));
+		RunningJobs.RemoveAtSwap(i, 1, false);
+	}
+	if (!RunningJobs.Num())
+	{
+		SetBuildLocked(false);
+	}
+	UE_CLOG(Cancelled.Num(), LogShoniNavWorker, Verbose, TEXT("Cancelled %i navmesh jobs for %s"), Cancelled.Num(), Level ? *Level->GetName() : TEXT("world cleanup"));
+	// the world is going, nobody is left to hear about it
+	if (!Level) return;
+	for (FJob& Job : Cancelled)
+	{
+		Job.OnDone(false);
+	}
+}
+
+void UShoniNavWorker::OnPreLevelRemoved(ULevel* Level, UWorld* World)
+{
+	if (World == GetWorld() && Level)
+	{
+		CancelJobs(Level);
+	}
+}
+
+void UShoniNavWorker::OnWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources)
+{
+	if (World == GetWorld())
+	{
+		CancelJobs(nullptr);
+		PendingJobs.Reset();
+	}
+}
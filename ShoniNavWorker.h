@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Async/Future.h"
+#include <atomic>
+#include "ShoniNavWorker.generated.h"
+
+class ARecastNavMesh;
+
+/* Read-only navmesh work off the game thread, kept clear of the navmesh changing underneath it. Jobs only start once no
+ * tiles are being built, navigation building is locked while any job runs, and level streaming or world teardown waits for
+ * the jobs reading a navmesh before it goes. Rebuilds get priority: once dirty areas are queued or the lock has been held
+ * for MAX_LOCK_SECONDS no new jobs start, so the running ones drain and the lock comes off. Nothing else in the tree reads the navmesh off the game thread outside the
+ * engine's own async queries, so everything that does goes through here */
+UCLASS()
+class SHONIISLAND_API UShoniNavWorker : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/* Work gets the navmesh and a flag set when the job is being cancelled, long jobs should check it and return early */
+	using FWork = TUniqueFunction<void(const ARecastNavMesh& NavMesh, const std::atomic<bool>& bCancelled)>;
+	/* bCompleted is false if the navmesh went away or the job was cancelled before Work finished */
+	using FOnDone = TUniqueFunction<void(bool bCompleted)>;
+
+	static UShoniNavWorker* Get(const UWorld* World);
+
+	/* Game thread only. Runs Work on a worker as soon as the navmesh is idle, then OnDone on the game thread, never before
+	 * this returns. OnDone is dropped without being called only when the world is torn down */
+	void Launch(ARecastNavMesh& NavMesh, FWork&& Work, FOnDone&& OnDone);
+	int32 GetNumPending() const { return PendingJobs.Num(); }
+	int32 GetNumRunning() const { return RunningJobs.Num(); }
+	bool IsHoldingBuildLock() const { return bHoldingBuildLock; }
+	/* Longest the build lock was held in one go, and longest queued dirty areas waited behind it, since the last reset */
+	float GetLongestBuildLock() const { return LongestBuildLock; }
+	float GetLongestRebuildWait() const { return LongestRebuildWait; }
+	void ResetLockStats() { LongestBuildLock = LongestRebuildWait = 0.f; }
+
+	// no new jobs start once the lock has been held this long, and after letting go it is only taken again once this long
+	// has passed for any queued dirty areas to turn into a build
+	static constexpr float MAX_LOCK_SECONDS = .25f;
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+private:
+	struct FJob
+	{
+		TWeakObjectPtr<ARecastNavMesh> NavMesh;
+		FWork Work;
+		FOnDone OnDone;
+		TSharedPtr<std::atomic<bool>> bCancelled;
+		TFuture<void> Future;
+	};
+	TArray<FJob> PendingJobs;
+	TArray<FJob> RunningJobs;
+	bool bHoldingBuildLock = false;
+	double LockTime = 0.0;
+	double UnlockTime = -1.0e10;
+	// when the navigation system last went from no dirty areas to some, negative while there are none
+	double DirtySince = -1.0;
+	float LongestBuildLock = 0.f;
+	float LongestRebuildWait = 0.f;
+	FDelegateHandle LevelRemovedHandle;
+	FDelegateHandle WorldCleanupHandle;
+
+	void SetBuildLocked(bool bLocked);
+	/* Cancels and waits out every running job reading from a navmesh in Level, or every job if Level is null */
+	void CancelJobs(const ULevel* Level);
+	void OnPreLevelRemoved(ULevel* Level, UWorld* World);
+	void OnWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources);
+};
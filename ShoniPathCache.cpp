@@ -0,0 +1,200 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShoniPathCache.h"
+#include "NavigationSystem.h"
+#include "NavMesh/RecastNavMesh.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogShoniPathCache, Log, All);
+
+UShoniPathCache* UShoniPathCache::Get(const UWorld* World)
+{
+	return World ? World->GetSubsystem<UShoniPathCache>() : nullptr;
+}
+
+bool UShoniPathCache::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld() && Super::ShouldCreateSubsystem(Outer);
+}
+
+void UShoniPathCache::Deinitialize()
+{
+	Reset();
+	Super::Deinitialize();
+}
+
+void UShoniPathCache::Reset()
+{
+	Entries.Reset();
+	LruList.Empty();
+	BytesUsed = 0;
+}
+
+void UShoniPathCache::SetMemoryBudget(int32 InMaxBytes)
+{
+	MaxBytes = FMath::Max(InMaxBytes, 0);
+	EvictToBudget();
+}
+
+FShoniPathCacheKey UShoniPathCache::MakeKey(const FVector& Start, const FVector& Goal, TSubclassOf<UNavigationQueryFilter> FilterClass) const
+{
+	FShoniPathCacheKey Key;
+	Key.StartCell = FIntVector(FMath::FloorToInt(Start.X / CELL_SIZE), FMath::FloorToInt(Start.Y / CELL_SIZE), FMath::FloorToInt(Start.Z / CELL_SIZE));
+	Key.GoalCell = FIntVector(FMath::FloorToInt(Goal.X / CELL_SIZE), FMath::FloorToInt(Goal.Y / CELL_SIZE), FMath::FloorToInt(Goal.Z / CELL_SIZE));
+	Key.FilterClass = FilterClass.Get();
+	return Key;
+}
+
+ARecastNavMesh* UShoniPathCache::GetNavMesh(const FPathFindingQuery& Query) const
+{
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	return NavSys ? Cast<ARecastNavMesh>(NavSys->GetNavDataForProps(Query.NavAgentProperties)) : nullptr;
+}
+
+void UShoniPathCache::RemoveEntry(const FShoniPathCacheKey& Key)
+{
+	FCacheEntry Entry;
+	if (Entries.RemoveAndCopyValue(Key, Entry))
+	{
+		LruList.RemoveNode(Entry.LruNode);
+		BytesUsed -= Entry.Bytes;
+	}
+}
+
+void UShoniPathCache::Touch(FCacheEntry& Entry)
+{
+	if (Entry.LruNode == LruList.GetTail()) return;
+	LruList.RemoveNode(Entry.LruNode, false);
+	LruList.AddTail(Entry.LruNode);
+}
+
+void UShoniPathCache::EvictToBudget()
+{
+	// out of date entries are dropped as soon as they're looked up, so plain LRU order is enough here
+	while (BytesUsed > MaxBytes && LruList.GetHead())
+	{
+		RemoveEntry(FShoniPathCacheKey(LruList.GetHead()->GetValue()));
+	}
+}
+
+FNavPathSharedPtr UShoniPathCache::FindPath(const FPathFindingQuery& Query, TSubclassOf<UNavigationQueryFilter> FilterClass)
+{
+	check(IsInGameThread());
+	++NumLookups;
+	const FShoniPathCacheKey Key = MakeKey(Query.StartLocation, Query.EndLocation, FilterClass);
+	FCacheEntry* Entry = Entries.Find(Key);
+	if (!Entry) return nullptr;
+	// a tile under the corridor was rebuilt
+	if (!Entry->Path->IsUpToDate())
+	{
+		RemoveEntry(Key);
+		return nullptr;
+	}
+
+	ARecastNavMesh* NavMesh = GetNavMesh(Query);
+	const FNavMeshPath* Cached = Entry->Path->CastPath<FNavMeshPath>();
+	if (!NavMesh || !Cached || Cached->PathCorridor.Num() == 0) return nullptr;
+
+	// the real start and goal must land on the cached corridor near its ends, otherwise it's a different route
+	const FVector Extent = NavMesh->GetDefaultQueryExtent();
+	const NavNodeRef StartPoly = NavMesh->FindNearestPoly(Query.StartLocation, Extent, Query.QueryFilter);
+	const NavNodeRef GoalPoly = NavMesh->FindNearestPoly(Query.EndLocation, Extent, Query.QueryFilter);
+	const TArray<NavNodeRef>& Corridor = Cached->PathCorridor;
+	int32 StartIdx = INDEX_NONE;
+	for (int32 i = 0; i < FMath::Min(CORRIDOR_SEARCH, Corridor.Num()); ++i)
+	{
+		if (Corridor[i] == StartPoly) { StartIdx = i; break; }
+	}
+	int32 GoalIdx = INDEX_NONE;
+	for (int32 i = Corridor.Num() - 1; i >= FMath::Max(Corridor.Num() - CORRIDOR_SEARCH, 0); --i)
+	{
+		if (Corridor[i] == GoalPoly) { GoalIdx = i; break; }
+	}
+	if (StartIdx == INDEX_NONE || GoalIdx == INDEX_NONE || GoalIdx < StartIdx) return nullptr;
+
+	// interior points, minus any that belong to polys trimmed off either end of the corridor
+	TSet<NavNodeRef> TrimmedPolys;
+	for (int32 i = 0; i < StartIdx; ++i) TrimmedPolys.Add(Corridor[i]);
+	for (int32 i = GoalIdx + 1; i < Corridor.Num(); ++i) TrimmedPolys.Add(Corridor[i]);
+	const TArray<FNavPathPoint>& CachedPoints = Cached->GetPathPoints();
+	TArray<FNavPathPoint> Interior;
+	for (int32 i = 1; i < CachedPoints.Num() - 1; ++i)
+	{
+		if (!TrimmedPolys.Contains(CachedPoints[i].NodeRef)) Interior.Add(CachedPoints[i]);
+	}
+
+	// string-pull from the agent's real start, skipping corners it can already see past
+	FVector HitLocation;
+	int32 FirstInterior = 0;
+	for (int32 n = 0; n < MAX_STRING_PULL && FirstInterior < Interior.Num(); ++n)
+	{
+		const FVector Next = FirstInterior + 1 < Interior.Num() ? Interior[FirstInterior + 1].Location : Query.EndLocation;
+		if (NavMesh->Raycast(Query.StartLocation, Next, HitLocation, Query.QueryFilter)) break;
+		++FirstInterior;
+	}
+	// the re-fitted ends have to be walkable
+	const FVector FirstTarget = FirstInterior < Interior.Num() ? Interior[FirstInterior].Location : Query.EndLocation;
+	const FVector LastCorner = Interior.Num() ? Interior.Last().Location : Query.StartLocation;
+	if (NavMesh->Raycast(Query.StartLocation, FirstTarget, HitLocation, Query.QueryFilter)
+		|| NavMesh->Raycast(LastCorner, Query.EndLocation, HitLocation, Query.QueryFilter))
+	{
+		return nullptr;
+	}
+
+	TSharedPtr<FNavMeshPath> NewPath = MakeShared<FNavMeshPath>();
+	TArray<FNavPathPoint>& Points = NewPath->GetPathPoints();
+	Points.Reserve(Interior.Num() - FirstInterior + 2);
+	Points.Add(FNavPathPoint(Query.StartLocation, StartPoly));
+	for (int32 i = FirstInterior; i < Interior.Num(); ++i)
+	{
+		Points.Add(Interior[i]);
+	}
+	Points.Add(FNavPathPoint(Query.EndLocation, GoalPoly));
+	NewPath->PathCorridor.Append(Corridor.GetData() + StartIdx, GoalIdx - StartIdx + 1);
+	if (Cached->PathCorridorCost.Num() == Corridor.Num())
+	{
+		NewPath->PathCorridorCost.Append(Cached->PathCorridorCost.GetData() + StartIdx, GoalIdx - StartIdx + 1);
+	}
+	NewPath->SetNavigationDataUsed(NavMesh);
+	NewPath->SetQuerier(Query.Owner.Get());
+	NewPath->SetTimeStamp(NavMesh->GetWorldTimeStamp());
+	NewPath->SetFilter(Query.QueryFilter);
+	NewPath->MarkReady();
+
+	Touch(*Entry);
+	++NumHits;
+	return NewPath;
+}
+
+void UShoniPathCache::AddPath(const FPathFindingQuery& Query, TSubclassOf<UNavigationQueryFilter> FilterClass, const FNavPathSharedPtr& InPath)
+{
+	check(IsInGameThread());
+	const FNavMeshPath* Source = InPath.IsValid() ? InPath->CastPath<FNavMeshPath>() : nullptr;
+	if (!Source || Source->IsPartial() || Source->GetPathPoints().Num() < 2 || Source->PathCorridor.Num() == 0) return;
+	ARecastNavMesh* NavMesh = GetNavMesh(Query);
+	if (!NavMesh) return;
+
+	const FShoniPathCacheKey Key = MakeKey(Query.StartLocation, Query.EndLocation, FilterClass);
+	RemoveEntry(Key);
+
+	// the agent's own path gets observers and goal tracking attached, the cache keeps a plain copy
+	TSharedPtr<FNavMeshPath> Copy = MakeShared<FNavMeshPath>();
+	Copy->GetPathPoints() = Source->GetPathPoints();
+	Copy->PathCorridor = Source->PathCorridor;
+	Copy->PathCorridorCost = Source->PathCorridorCost;
+	Copy->SetNavigationDataUsed(NavMesh);
+	Copy->SetTimeStamp(NavMesh->GetWorldTimeStamp());
+	Copy->EnableRecalculationOnInvalidation(false);
+	Copy->MarkReady();
+	NavMesh->RegisterActivePath(Copy);
+
+	FCacheEntry& Entry = Entries.Add(Key);
+	Entry.Path = Copy;
+	LruList.AddTail(Key);
+	Entry.LruNode = LruList.GetTail();
+	Entry.Bytes = sizeof(FCacheEntry) + sizeof(FNavMeshPath) + Copy->GetPathPoints().GetAllocatedSize()
+		+ Copy->PathCorridor.GetAllocatedSize() + Copy->PathCorridorCost.GetAllocatedSize();
+	BytesUsed += Entry.Bytes;
+	EvictToBudget();
+	UE_LOG(LogShoniPathCache, VeryVerbose, TEXT("Cached path with %i points. %i entries, %i bytes, hit rate %.2f"), Copy->GetPathPoints().Num(), Entries.Num(), BytesUsed, GetHitRate());
+}
@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "NavigationData.h"
+#include "NavFilters/NavigationQueryFilter.h"
+#include "Containers/List.h"
+#include "ShoniPathCache.generated.h"
+
+class ARecastNavMesh;
+
+/* Start/goal quantised to cells so agents leaving from roughly the same place for roughly the same place share a path */
+struct FShoniPathCacheKey
+{
+	FIntVector StartCell;
+	FIntVector GoalCell;
+	const UClass* FilterClass = nullptr;
+
+	bool operator==(const FShoniPathCacheKey& Other) const { return StartCell == Other.StartCell && GoalCell == Other.GoalCell && FilterClass == Other.FilterClass; }
+	friend uint32 GetTypeHash(const FShoniPathCacheKey& Key) { return HashCombine(HashCombine(GetTypeHash(Key.StartCell), GetTypeHash(Key.GoalCell)), PointerHash(Key.FilterClass)); }
+};
+
+/* Shared cache of full navmesh paths. Hits are re-fitted to the requesting agent's real start and goal, entries are dropped
+ * when the navmesh tiles under them rebuild and the least recently used are evicted past a memory cap */
+UCLASS()
+class SHONIISLAND_API UShoniPathCache : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UShoniPathCache* Get(const UWorld* World);
+
+	/* Game thread only. Null on a miss. A hit is a new path owned by the caller, already snapped and string-pulled to the query's start and goal */
+	FNavPathSharedPtr FindPath(const FPathFindingQuery& Query, TSubclassOf<UNavigationQueryFilter> FilterClass);
+	/* Game thread only. Stores a copy of a complete navmesh path for the query, partial paths are ignored */
+	void AddPath(const FPathFindingQuery& Query, TSubclassOf<UNavigationQueryFilter> FilterClass, const FNavPathSharedPtr& InPath);
+	void Reset();
+
+	void SetMemoryBudget(int32 InMaxBytes);
+	int32 GetMemoryUsed() const { return BytesUsed; }
+	int32 GetNumEntries() const { return Entries.Num(); }
+	float GetHitRate() const { return NumLookups ? float(NumHits) / NumLookups : 0.f; }
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Deinitialize() override;
+
+private:
+	struct FCacheEntry
+	{
+		// owned copy, registered with the nav data as an active path so tile rebuilds under its corridor mark it out of date
+		FNavPathSharedPtr Path;
+		// owned by LruList
+		TDoubleLinkedList<FShoniPathCacheKey>::TDoubleLinkedListNode* LruNode = nullptr;
+		int32 Bytes = 0;
+	};
+	TMap<FShoniPathCacheKey, FCacheEntry> Entries;
+	// least recently used at the head, so eviction never scans
+	TDoubleLinkedList<FShoniPathCacheKey> LruList;
+	int32 BytesUsed = 0;
+	int32 MaxBytes = 2 * 1024 * 1024;
+	uint32 NumLookups = 0;
+	uint32 NumHits = 0;
+	// a hit's start and goal polys have to be within this many polys of the cached corridor's ends
+	const int32 CORRIDOR_SEARCH = 8;
+	// cached points skipped past the real start while the navmesh stays clear
+	const int32 MAX_STRING_PULL = 3;
+	const float CELL_SIZE = 300.f;
+
+	FShoniPathCacheKey MakeKey(const FVector& Start, const FVector& Goal, TSubclassOf<UNavigationQueryFilter> FilterClass) const;
+	ARecastNavMesh* GetNavMesh(const FPathFindingQuery& Query) const;
+	void RemoveEntry(const FShoniPathCacheKey& Key);
+	void Touch(FCacheEntry& Entry);
+	void EvictToBudget();
+};
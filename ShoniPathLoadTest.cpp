@@ -0,0 +1,489 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AITask_AsyncMoveTo.h"
+#include "ShoniPathStats.h"
+#include "ShoniNavWorker.h"
+#include "AIController.h"
+#include "NavigationSystem.h"
+#include "GameFramework/Character.h"
+#include "Containers/Ticker.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "RenderCore.h"
+
+#if !UE_BUILD_SHIPPING
+
+DEFINE_LOG_CATEGORY_STATIC(LogShoniPathLoadTest, Log, All);
+
+/* Movement load test. Spawns N AI characters on the current map's navmesh and keeps every one of them busy with
+ * AsyncMoveTo for a fixed time, then reports path requests per second, p50/p99 path latency, game thread ms per
+ * frame and how many moves completed. Runs over real frames, so to run it headless load a navmesh test map with e.g.
+ *   UnrealEditor-Cmd ShoniIsland.uproject /Game/Maps/NavLoadTest -game -nullrhi -nosound -unattended -ExecCmds="Shoni.Pathing.LoadTest 1000 mixed 60 quit"
+ * Workloads: random goals, a few shared goals (flow fields), chasing wandering targets, or mixed thirds of each.
+ * Move LOD is off unless 'lod' is passed: headless nothing renders, so far agents would be simulated instead of pathed.
+ * 'rebuild' dirties the navmesh round a random agent every REBUILD_INTERVAL seconds, so how long the navmesh workers keep
+ * dynamic rebuilds waiting is measured too (needs dynamic runtime generation on the test map).
+ * Run with: Shoni.Pathing.LoadTest [Agents] [random|shared|chase|mixed] [Seconds] [Seed] [CsvPath] [quit] [lod] [rebuild] */
+struct FShoniPathLoadTest
+{
+	enum EWorkload
+	{
+		WL_Random,
+		WL_Shared,
+		WL_Chase,
+		WL_Mixed
+	};
+
+	struct FAgent
+	{
+		TWeakObjectPtr<AAIController> Controller;
+		TWeakObjectPtr<UAITask_AsyncMoveTo> Task;
+		EWorkload Workload;
+		// the target's own wander doesn't count towards the results
+		bool bChaseTarget;
+		// the current move tracks a target, falls back to random when there's none
+		bool bChasing;
+	};
+
+	struct FFrameSample
+	{
+		double Time;
+		float FrameMs;
+		float GameThreadMs;
+		int32 NumRequests;
+		int32 NumInFlight;
+		int32 NumCompleted;
+		int32 NumFailed;
+		bool bNavLocked;
+		bool bDirtyAreasQueued;
+	};
+
+	static constexpr int32 MIN_AGENTS = 100;
+	static constexpr int32 MAX_AGENTS = 5000;
+	static constexpr int32 NUM_SHARED_GOALS = 4;
+	// one wandering target per this many chasers
+	static constexpr int32 CHASERS_PER_TARGET = 50;
+	// moves are issued after this many frames so spawning and the first nav tick don't skew the numbers
+	static constexpr int32 WARMUP_FRAMES = 30;
+	static constexpr float ACCEPTANCE_RADIUS = 100.f;
+	// random goals are drawn up front so projecting them isn't timed with the moves
+	static constexpr int32 GOAL_POOL_SIZE = 1024;
+	static constexpr float REBUILD_INTERVAL = 2.f;
+	static constexpr float REBUILD_EXTENT = 1000.f;
+
+	static TSharedPtr<FShoniPathLoadTest> ActiveTest;
+
+	TWeakObjectPtr<UWorld> World;
+	EWorkload Workload = WL_Mixed;
+	float Duration = 60.f;
+	FRandomStream Stream;
+	FString CsvPath;
+	bool bQuitWhenDone = false;
+	bool bUseMoveLOD = false;
+	bool bRebuild = false;
+	double LastRebuildTime = 0.0;
+
+	TArray<FAgent> Agents;
+	TArray<TWeakObjectPtr<ACharacter>> Targets;
+	TArray<FVector> SharedGoals;
+	TArray<FVector> GoalPool;
+	TArray<FFrameSample> Samples;
+
+	int32 Frame = 0;
+	double StartTime = 0.0;
+	int64 StartRequests = 0;
+	FShoniHistogram StartLatency;
+	int32 NumIssued = 0;
+	int32 NumCompleted = 0;
+	int32 NumFailed = 0;
+	int32 FrameCompleted = 0;
+	int32 FrameFailed = 0;
+	int32 NumChaseMoves = 0;
+	int32 NumChaseRepaths = 0;
+
+	static const TCHAR* GetWorkloadName(EWorkload InWorkload)
+	{
+		switch (InWorkload)
+		{
+		case WL_Random:	return TEXT("random");
+		case WL_Shared:	return TEXT("shared");
+		case WL_Chase:	return TEXT("chase");
+		default:		return TEXT("mixed");
+		}
+	}
+
+	static void Run(const TArray<FString>& InArgs, UWorld* InWorld)
+	{
+		if (ActiveTest.IsValid())
+		{
+			UE_LOG(LogShoniPathLoadTest, Warning, TEXT("A load test is already running"));
+			return;
+		}
+		TArray<FString> Args = InArgs;
+		const bool bQuit = Args.Remove(TEXT("quit")) > 0;
+		const bool bMoveLOD = Args.Remove(TEXT("lod")) > 0;
+		const bool bRebuild = Args.Remove(TEXT("rebuild")) > 0;
+
+		TSharedPtr<FShoniPathLoadTest> Test = MakeShared<FShoniPathLoadTest>();
+		const int32 NumAgents = FMath::Clamp(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000, MIN_AGENTS, MAX_AGENTS);
+		if (Args.Num() > 1)
+		{
+			for (int32 i = WL_Random; i <= WL_Mixed; ++i)
+			{
+				if (Args[1].Equals(GetWorkloadName((EWorkload)i), ESearchCase::IgnoreCase))
+				{
+					Test->Workload = (EWorkload)i;
+				}
+			}
+		}
+		Test->Duration = FMath::Max(Args.Num() > 2 ? FCString::Atof(*Args[2]) : 60.f, 1.f);
+		Test->Stream.Initialize(Args.Num() > 3 ? FCString::Atoi(*Args[3]) : 0);
+		Test->CsvPath = Args.Num() > 4 ? Args[4] : FPaths::ProfilingDir() / TEXT("ShoniPathing") / FString::Printf(TEXT("LoadTest_%s_%i%s%s_%s.csv"), GetWorkloadName(Test->Workload), NumAgents, bMoveLOD ? TEXT("_lod") : TEXT(""), bRebuild ? TEXT("_rebuild") : TEXT(""), *FDateTime::Now().ToString());
+		Test->bQuitWhenDone = bQuit;
+		Test->bUseMoveLOD = bMoveLOD;
+		Test->bRebuild = bRebuild;
+		Test->World = InWorld;
+
+		if (!Test->Spawn(NumAgents))
+		{
+			if (bQuit)
+			{
+				FPlatformMisc::RequestExit(false);
+			}
+			return;
+		}
+		ActiveTest = Test;
+		// the ticker holds the test until Tick returns false
+		FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([Test](float DeltaTime) { return Test->Tick(DeltaTime); }));
+		UE_LOG(LogShoniPathLoadTest, Display, TEXT("Load test started: %i agents, %s, %.0fs, move LOD %s, rebuilds %s"), Test->Agents.Num() - Test->Targets.Num(), GetWorkloadName(Test->Workload), Test->Duration, bMoveLOD ? TEXT("on") : TEXT("off"), bRebuild ? TEXT("on") : TEXT("off"));
+	}
+
+	bool RandomNavPoint(FVector& OutLocation)
+	{
+		UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World.Get());
+		const ANavigationData* NavData = NavSys ? NavSys->GetDefaultNavDataInstance() : nullptr;
+		if (!NavData) return false;
+		// the navmesh's own random point isn't seeded, draw inside its bounds from our stream instead
+		const FBox Bounds = NavData->GetBounds();
+		const FVector Origin = Bounds.GetCenter() + FVector(Stream.FRandRange(-1.f, 1.f), Stream.FRandRange(-1.f, 1.f), 0.f) * Bounds.GetExtent();
+		FNavLocation Location;
+		if (!NavSys->ProjectPointToNavigation(Origin, Location, FVector(Bounds.GetExtent().X * .1f, Bounds.GetExtent().Y * .1f, Bounds.GetExtent().Z), NavData))
+		{
+			return false;
+		}
+		OutLocation = Location.Location;
+		return true;
+	}
+
+	AAIController* SpawnCharacter(const FVector& Location)
+	{
+		FActorSpawnParameters Params;
+		Params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		ACharacter* Character = World->SpawnActor<ACharacter>(ACharacter::StaticClass(), Location + FVector(0.f, 0.f, 100.f), FRotator(0.f, Stream.FRandRange(0.f, 360.f), 0.f), Params);
+		if (!Character) return nullptr;
+		Character->SpawnDefaultController();
+		return Cast<AAIController>(Character->GetController());
+	}
+
+	bool Spawn(int32 NumAgents)
+	{
+		FVector Location;
+		if (!World.IsValid() || !UShoniPathStats::Get(World.Get()) || !RandomNavPoint(Location))
+		{
+			UE_LOG(LogShoniPathLoadTest, Warning, TEXT("Needs a game world with a navmesh"));
+			return false;
+		}
+		for (int32 i = 0; i < NUM_SHARED_GOALS; ++i)
+		{
+			if (RandomNavPoint(Location))
+			{
+				SharedGoals.Add(Location);
+			}
+		}
+		for (int32 i = 0; i < GOAL_POOL_SIZE; ++i)
+		{
+			if (RandomNavPoint(Location))
+			{
+				GoalPool.Add(Location);
+			}
+		}
+
+		Agents.Reserve(NumAgents + NumAgents / CHASERS_PER_TARGET + 1);
+		for (int32 i = 0; i < NumAgents; ++i)
+		{
+			if (!RandomNavPoint(Location)) continue;
+			AAIController* Controller = SpawnCharacter(Location);
+			if (!Controller) continue;
+			FAgent& Agent = Agents.AddDefaulted_GetRef();
+			Agent.Controller = Controller;
+			// round robin keeps the mix even at any count
+			Agent.Workload = Workload == WL_Mixed ? (EWorkload)(i % WL_Mixed) : Workload;
+			Agent.bChaseTarget = false;
+			Agent.bChasing = false;
+		}
+		const bool bWantsTargets = Workload == WL_Chase || Workload == WL_Mixed;
+		for (int32 i = 0; bWantsTargets && i <= NumAgents / CHASERS_PER_TARGET; ++i)
+		{
+			if (!RandomNavPoint(Location)) continue;
+			AAIController* Controller = SpawnCharacter(Location);
+			if (!Controller) continue;
+			Targets.Add(Cast<ACharacter>(Controller->GetPawn()));
+			FAgent& Agent = Agents.AddDefaulted_GetRef();
+			Agent.Controller = Controller;
+			Agent.Workload = WL_Random;
+			Agent.bChaseTarget = true;
+			Agent.bChasing = false;
+		}
+		if (!Agents.Num())
+		{
+			UE_LOG(LogShoniPathLoadTest, Warning, TEXT("Couldn't spawn any agents on this navmesh"));
+			return false;
+		}
+		return true;
+	}
+
+	void IssueMove(FAgent& Agent)
+	{
+		AAIController* Controller = Agent.Controller.Get();
+		if (!Controller || !Controller->GetPawn()) return;
+
+		FVector Goal = FVector::ZeroVector;
+		AActor* GoalActor = nullptr;
+		EWorkload AgentWorkload = Agent.Workload;
+		if (AgentWorkload == WL_Shared && !SharedGoals.Num())
+		{
+			AgentWorkload = WL_Random;
+		}
+		if (AgentWorkload == WL_Chase)
+		{
+			GoalActor = Targets.Num() ? Targets[Stream.RandHelper(Targets.Num())].Get() : nullptr;
+			if (!GoalActor)
+			{
+				AgentWorkload = WL_Random;
+			}
+		}
+		if (AgentWorkload == WL_Random)
+		{
+			if (!GoalPool.Num()) return;
+			Goal = GoalPool[Stream.RandHelper(GoalPool.Num())];
+		}
+		if (AgentWorkload == WL_Shared)
+		{
+			Goal = SharedGoals[Stream.RandHelper(SharedGoals.Num())];
+		}
+
+		// chasers follow the target as it wanders, which is where the repaths come from
+		UAITask_AsyncMoveTo* Task = UAITask_AsyncMoveTo::AIMoveTo(Controller, Goal, GoalActor, ACCEPTANCE_RADIUS, EAIOptionFlag::Default, EAIOptionFlag::Default, true, false, AgentWorkload == WL_Chase);
+		if (!Task) return;
+		Task->SetUseFlowField(AgentWorkload == WL_Shared);
+		Task->SetUseMoveLOD(bUseMoveLOD);
+		Task->ReadyForActivation();
+		Agent.Task = Task;
+		Agent.bChasing = AgentWorkload == WL_Chase;
+		if (!Agent.bChaseTarget)
+		{
+			++NumIssued;
+		}
+	}
+
+	void DirtyNavMesh()
+	{
+		LastRebuildTime = FPlatformTime::Seconds();
+		UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World.Get());
+		const FAgent& Agent = Agents[Stream.RandHelper(Agents.Num())];
+		const APawn* Pawn = Agent.Controller.IsValid() ? Agent.Controller->GetPawn() : nullptr;
+		if (!NavSys || !Pawn) return;
+		// where agents are pathing, so the rebuild lands under live corridors and fields
+		NavSys->AddDirtyArea(FBox::BuildAABB(Pawn->GetActorLocation(), FVector(REBUILD_EXTENT)), ENavigationDirtyFlag::All);
+	}
+
+	void PollAgent(FAgent& Agent)
+	{
+		UAITask_AsyncMoveTo* Task = Agent.Task.Get();
+		if (Task && !Task->IsFinished()) return;
+		// a task that got collected before we saw it finish can't tell us how it went
+		if (Task && !Agent.bChaseTarget)
+		{
+			if (Task->WasMoveSuccessful())
+			{
+				++FrameCompleted;
+			}
+			else
+			{
+				++FrameFailed;
+			}
+			if (Agent.bChasing)
+			{
+				++NumChaseMoves;
+				NumChaseRepaths += Task->GetNumRepaths();
+			}
+		}
+		Agent.Task.Reset();
+		IssueMove(Agent);
+	}
+
+	bool Tick(float DeltaTime)
+	{
+		UShoniPathStats* Stats = UShoniPathStats::Get(World.Get());
+		if (!Stats)
+		{
+			UE_LOG(LogShoniPathLoadTest, Warning, TEXT("World went away, load test abandoned"));
+			Finish(false);
+			return false;
+		}
+
+		if (++Frame < WARMUP_FRAMES) return true;
+		if (Frame == WARMUP_FRAMES)
+		{
+			StartTime = FPlatformTime::Seconds();
+			StartRequests = Stats->GetNumRequestsTotal();
+			StartLatency = Stats->GetLatencyHistogram();
+			LastRebuildTime = StartTime;
+			if (UShoniNavWorker* Worker = UShoniNavWorker::Get(World.Get()))
+			{
+				Worker->ResetLockStats();
+			}
+			for (FAgent& Agent : Agents)
+			{
+				IssueMove(Agent);
+			}
+			return true;
+		}
+
+		FrameCompleted = 0;
+		FrameFailed = 0;
+		for (FAgent& Agent : Agents)
+		{
+			PollAgent(Agent);
+		}
+		NumCompleted += FrameCompleted;
+		NumFailed += FrameFailed;
+		if (bRebuild && FPlatformTime::Seconds() - LastRebuildTime >= REBUILD_INTERVAL)
+		{
+			DirtyNavMesh();
+		}
+
+		FFrameSample& Sample = Samples.AddDefaulted_GetRef();
+		Sample.Time = FPlatformTime::Seconds() - StartTime;
+		Sample.FrameMs = DeltaTime * 1000.f;
+		// last frame's, the current one hasn't been measured yet
+		Sample.GameThreadMs = FPlatformTime::ToMilliseconds(GGameThreadTime);
+		Sample.NumRequests = Stats->GetNumRequestsTotal() - StartRequests;
+		Sample.NumInFlight = Stats->GetNumInFlight();
+		Sample.NumCompleted = FrameCompleted;
+		Sample.NumFailed = FrameFailed;
+		const UShoniNavWorker* Worker = UShoniNavWorker::Get(World.Get());
+		const UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World.Get());
+		Sample.bNavLocked = Worker && Worker->IsHoldingBuildLock();
+		Sample.bDirtyAreasQueued = NavSys && NavSys->HasDirtyAreasQueued();
+
+		if (Sample.Time < Duration) return true;
+		Finish(true);
+		return false;
+	}
+
+	void Report(const UShoniPathStats& Stats) const
+	{
+		// only this run's share of the world's latency histogram
+		FShoniHistogram Latency = Stats.GetLatencyHistogram();
+		for (int32 Bucket = 0; Bucket < Latency.Counts.Num() && Bucket < StartLatency.Counts.Num(); ++Bucket)
+		{
+			Latency.Counts[Bucket] -= StartLatency.Counts[Bucket];
+		}
+		Latency.NumSamples -= StartLatency.NumSamples;
+		Latency.Sum -= StartLatency.Sum;
+
+		const double Elapsed = FMath::Max(Samples.Num() ? Samples.Last().Time : 0.0, UE_SMALL_NUMBER);
+		const int32 NumRequests = Samples.Num() ? Samples.Last().NumRequests : 0;
+		double GameThreadTotal = 0.0;
+		float GameThreadWorst = 0.f;
+		TArray<float> FrameTimes;
+		FrameTimes.Reserve(Samples.Num());
+		for (const FFrameSample& Sample : Samples)
+		{
+			GameThreadTotal += Sample.GameThreadMs;
+			GameThreadWorst = FMath::Max(GameThreadWorst, Sample.GameThreadMs);
+			FrameTimes.Add(Sample.GameThreadMs);
+		}
+		FrameTimes.Sort();
+		const float GameThreadP99 = FrameTimes.Num() ? FrameTimes[FMath::Min(FMath::FloorToInt(FrameTimes.Num() * .99f), FrameTimes.Num() - 1)] : 0.f;
+
+		int32 NumLockedFrames = 0;
+		int32 NumDirtyLockedFrames = 0;
+		for (const FFrameSample& Sample : Samples)
+		{
+			NumLockedFrames += Sample.bNavLocked;
+			NumDirtyLockedFrames += Sample.bNavLocked && Sample.bDirtyAreasQueued;
+		}
+		// chases still underway when time ran out have repathed too
+		int32 ChaseMoves = NumChaseMoves;
+		int32 ChaseRepaths = NumChaseRepaths;
+		for (const FAgent& Agent : Agents)
+		{
+			const UAITask_AsyncMoveTo* Task = Agent.Task.Get();
+			if (!Task || !Agent.bChasing || Agent.bChaseTarget) continue;
+			++ChaseMoves;
+			ChaseRepaths += Task->GetNumRepaths();
+		}
+		if (ChaseMoves)
+		{
+			UE_LOG(LogShoniPathLoadTest, Display, TEXT("Chase moves %i, %.2f repaths per move"), ChaseMoves, float(ChaseRepaths) / ChaseMoves);
+		}
+
+		const UShoniNavWorker* Worker = UShoniNavWorker::Get(World.Get());
+		UE_LOG(LogShoniPathLoadTest, Display, TEXT("Navmesh workers held the build lock %.1f%% of frames (longest %.0fms), rebuilds waited behind it %i frames (longest %.0fms)"),
+			Samples.Num() ? 100.f * NumLockedFrames / Samples.Num() : 0.f, Worker ? Worker->GetLongestBuildLock() * 1000.f : 0.f,
+			NumDirtyLockedFrames, Worker ? Worker->GetLongestRebuildWait() * 1000.f : 0.f);
+
+		// moves still underway when time ran out are neither
+		const int32 NumFinished = NumCompleted + NumFailed;
+		UE_LOG(LogShoniPathLoadTest, Display, TEXT("%s, %i agents, move LOD %s, %.1fs: %.1f path requests/s, latency p50 <= %.0fms p99 <= %.0fms (avg %.2fms). Game thread avg %.2fms, p99 %.2fms, worst %.2fms. Moves issued %i, completed %i, failed %i (%.1f%% of finished succeeded)"),
+			GetWorkloadName(Workload), Agents.Num() - Targets.Num(), bUseMoveLOD ? TEXT("on") : TEXT("off"), Elapsed, NumRequests / Elapsed, Latency.GetPercentile(.5f), Latency.GetPercentile(.99f), Latency.GetAverage(),
+			Samples.Num() ? GameThreadTotal / Samples.Num() : 0.0, GameThreadP99, GameThreadWorst, NumIssued, NumCompleted, NumFailed, NumFinished ? 100.f * NumCompleted / NumFinished : 0.f);
+
+		FString Csv = TEXT("Time,FrameMs,GameThreadMs,Requests,InFlight,Completed,Failed,NavLocked,DirtyAreasQueued\n");
+		for (const FFrameSample& Sample : Samples)
+		{
+			Csv += FString::Printf(TEXT("%.3f,%.2f,%.2f,%i,%i,%i,%i,%i,%i\n"), Sample.Time, Sample.FrameMs, Sample.GameThreadMs, Sample.NumRequests, Sample.NumInFlight, Sample.NumCompleted, Sample.NumFailed, Sample.bNavLocked, Sample.bDirtyAreasQueued);
+		}
+		if (FFileHelper::SaveStringToFile(Csv, *CsvPath))
+		{
+			UE_LOG(LogShoniPathLoadTest, Display, TEXT("Load test written to %s"), *CsvPath);
+		}
+	}
+
+	void Finish(bool bReport)
+	{
+		const UShoniPathStats* Stats = UShoniPathStats::Get(World.Get());
+		if (bReport && Stats)
+		{
+			Report(*Stats);
+		}
+		for (FAgent& Agent : Agents)
+		{
+			AAIController* Controller = Agent.Controller.Get();
+			if (!Controller) continue;
+			if (APawn* Pawn = Controller->GetPawn())
+			{
+				Pawn->Destroy();
+			}
+			Controller->Destroy();
+		}
+		Agents.Reset();
+		if (bQuitWhenDone)
+		{
+			FPlatformMisc::RequestExit(false);
+		}
+		ActiveTest.Reset();
+	}
+};
+
+TSharedPtr<FShoniPathLoadTest> FShoniPathLoadTest::ActiveTest;
+
+static FAutoConsoleCommandWithWorldAndArgs ShoniPathLoadTestCommand(
+	TEXT("Shoni.Pathing.LoadTest"),
+	TEXT("Spawns AI characters and keeps them moving with AsyncMoveTo, then reports path throughput, latency, game thread time and completion rates. Args: [Agents] [random|shared|chase|mixed] [Seconds] [Seed] [CsvPath] [quit] [lod] [rebuild]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&FShoniPathLoadTest::Run));
+
+#endif
@@ -0,0 +1,149 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShoniPathScheduler.h"
+#include "NavigationSystem.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
+#include "ShoniSignificanceManager.h"
+#include <algorithm>
+
+DEFINE_LOG_CATEGORY_STATIC(LogShoniPathScheduler, Log, All);
+
+UShoniPathScheduler* UShoniPathScheduler::Get(const UWorld* World)
+{
+	return World ? World->GetSubsystem<UShoniPathScheduler>() : nullptr;
+}
+
+bool UShoniPathScheduler::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld() && Super::ShouldCreateSubsystem(Outer);
+}
+
+TStatId UShoniPathScheduler::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShoniPathScheduler, STATGROUP_Tickables);
+}
+
+uint32 UShoniPathScheduler::RequestPath(AActor* Agent, const FPathFindingQuery& Query, const FNavPathQueryDelegate& ResultDelegate, EPathFindingMode::Type Mode)
+{
+	FQueuedPathRequest& Request = Queue.AddDefaulted_GetRef();
+	Request.Ticket = NextTicket++;
+	// 0 is reserved for "no request"
+	if (NextTicket == 0) NextTicket = 1;
+	Request.Query = Query;
+	Request.ResultDelegate = ResultDelegate;
+	Request.Mode = Mode;
+	Request.Priority = ScoreAgent(Agent);
+	Request.EnqueueTime = FPlatformTime::Seconds();
+	return Request.Ticket;
+}
+
+bool UShoniPathScheduler::CancelRequest(uint32 Ticket)
+{
+	if (Ticket == 0) return false;
+	const int32 Idx = Queue.IndexOfByPredicate([Ticket](const FQueuedPathRequest& Request) { return Request.Ticket == Ticket; });
+	if (Idx != INDEX_NONE)
+	{
+		Queue.RemoveAtSwap(Idx, 1, false);
+		return true;
+	}
+	FInFlightPathRequest InFlight;
+	if (!InFlightRequests.RemoveAndCopyValue(Ticket, InFlight)) return false;
+	// frees the worker if it hasn't picked the query up yet. If it has, the result is dropped in OnPathResult
+	if (UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()))
+	{
+		NavSys->AbortAsyncFindPathRequest(InFlight.QueryID);
+	}
+	return true;
+}
+
+void UShoniPathScheduler::OnPathResult(uint32 QueryID, ENavigationQueryResult::Type Result, FNavPathSharedPtr Path, uint32 Ticket)
+{
+	FInFlightPathRequest InFlight;
+	if (!InFlightRequests.RemoveAndCopyValue(Ticket, InFlight)) return;
+	InFlight.ResultDelegate.ExecuteIfBound(QueryID, Result, Path);
+}
+
+float UShoniPathScheduler::GetOldestWaitTime() const
+{
+	double Oldest = 0.0;
+	const double Now = FPlatformTime::Seconds();
+	for (const FQueuedPathRequest& Request : Queue)
+	{
+		Oldest = FMath::Max(Oldest, Now - Request.EnqueueTime);
+	}
+	return Oldest;
+}
+
+float UShoniPathScheduler::ScoreAgent(AActor* Agent) const
+{
+	if (!Agent) return 0.f;
+	// significance already folds in camera distance, facing and importance
+	const float Significance = UShoniSignificanceManager::GetSignificance(Agent);
+	if (Significance > 0.f) return FMath::Min(Significance, 1.f);
+
+	// unregistered or culled, fall back to raw distance from the local camera
+	const APlayerController* PC = GetWorld()->GetFirstPlayerController();
+	if (!PC || !PC->PlayerCameraManager) return 0.f;
+	const float Dist = FVector::Dist(PC->PlayerCameraManager->GetCameraLocation(), Agent->GetActorLocation());
+	return FMath::Clamp(1.f - Dist / CAM_DIST_MAX, 0.f, 1.f);
+}
+
+void UShoniPathScheduler::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+	if (Queue.IsEmpty()) return;
+
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	if (!NavSys) return;
+
+	const double Now = FPlatformTime::Seconds();
+	const int32 NumToDispatch = FMath::Min(MaxDispatchPerFrame, Queue.Num());
+	DispatchOrder.SetNum(Queue.Num(), false);
+	EffectivePriorities.SetNum(Queue.Num(), false);
+	for (int32 i = 0; i < Queue.Num(); ++i)
+	{
+		DispatchOrder[i] = i;
+		EffectivePriorities[i] = Queue[i].Priority + (Now - Queue[i].EnqueueTime) * AGING_RATE;
+	}
+	// partial selection, the order within the dispatched set doesn't matter
+	if (NumToDispatch < Queue.Num())
+	{
+		int32* First = DispatchOrder.GetData();
+		std::nth_element(First, First + NumToDispatch, First + DispatchOrder.Num(), [this](int32 A, int32 B)
+			{
+				return EffectivePriorities[A] > EffectivePriorities[B];
+			});
+	}
+	DispatchOrder.SetNum(NumToDispatch, false);
+
+	// failures are reported once the queue is settled, the callback is free to request again
+	TArray<FNavPathQueryDelegate> FailedDispatches;
+	for (int32 Idx : DispatchOrder)
+	{
+		FQueuedPathRequest& Request = Queue[Idx];
+		AverageWaitTime = FMath::Lerp(AverageWaitTime, float(Now - Request.EnqueueTime), .1f);
+		const uint32 QueryID = NavSys->FindPathAsync(Request.Query.NavAgentProperties, Request.Query,
+			FNavPathQueryDelegate::CreateUObject(this, &UShoniPathScheduler::OnPathResult, Request.Ticket), Request.Mode);
+		if (QueryID == INVALID_NAVQUERYID)
+		{
+			FailedDispatches.Add(MoveTemp(Request.ResultDelegate));
+			continue;
+		}
+		InFlightRequests.Add(Request.Ticket, { QueryID, MoveTemp(Request.ResultDelegate) });
+	}
+
+	// remove back to front so swap-removal doesn't move anything still to be removed
+	DispatchOrder.Sort(TGreater<int32>());
+	for (int32 Idx : DispatchOrder)
+	{
+		Queue.RemoveAtSwap(Idx, 1, false);
+	}
+	UE_LOG(LogShoniPathScheduler, VeryVerbose, TEXT("Dispatched %i path requests, %i queued, %i in flight, avg wait %.3fs"), NumToDispatch, Queue.Num(), InFlightRequests.Num(), AverageWaitTime);
+
+	for (const FNavPathQueryDelegate& ResultDelegate : FailedDispatches)
+	{
+		ResultDelegate.ExecuteIfBound(INVALID_NAVQUERYID, ENavigationQueryResult::Error, nullptr);
+	}
+}
@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "NavigationData.h"
+#include "ShoniPathScheduler.generated.h"
+
+/* Queues async path queries and releases a budgeted number to the navmesh workers per frame, most important agents
+ * first. Waiting requests age upwards so low priority agents still get served under sustained load */
+UCLASS()
+class SHONIISLAND_API UShoniPathScheduler : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/* Null for worlds without navigation (editor previews etc) */
+	static UShoniPathScheduler* Get(const UWorld* World);
+
+	/* Queues a query for dispatch. Priority comes from the agent's significance, or its distance to the camera if it has none.
+	 * Returns a ticket for CancelRequest */
+	uint32 RequestPath(AActor* Agent, const FPathFindingQuery& Query, const FNavPathQueryDelegate& ResultDelegate, EPathFindingMode::Type Mode = EPathFindingMode::Regular);
+	/* Drops a queued request, or aborts it on the navmesh workers if already dispatched. Its delegate will not fire.
+	 * False if the ticket is unknown or its result has already been delivered */
+	bool CancelRequest(uint32 Ticket);
+
+	void SetMaxDispatchPerFrame(int32 InMaxDispatch) { MaxDispatchPerFrame = FMath::Max(InMaxDispatch, 1); }
+	int32 GetMaxDispatchPerFrame() const { return MaxDispatchPerFrame; }
+	/* Requests waiting to be dispatched */
+	int32 GetQueueDepth() const { return Queue.Num(); }
+	/* Requests dispatched and waiting on a result */
+	int32 GetNumInFlight() const { return InFlightRequests.Num(); }
+	/* Smoothed seconds between RequestPath and dispatch */
+	float GetAverageWaitTime() const { return AverageWaitTime; }
+	/* Seconds the longest waiting request has been queued for */
+	float GetOldestWaitTime() const;
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+private:
+	struct FQueuedPathRequest
+	{
+		uint32 Ticket = 0;
+		FPathFindingQuery Query;
+		FNavPathQueryDelegate ResultDelegate;
+		TEnumAsByte<EPathFindingMode::Type> Mode = EPathFindingMode::Regular;
+		// 0-1 at enqueue, aging is added on top at dispatch time
+		float Priority = 0.f;
+		double EnqueueTime = 0.0;
+	};
+	TArray<FQueuedPathRequest> Queue;
+	struct FInFlightPathRequest
+	{
+		uint32 QueryID = INVALID_NAVQUERYID;
+		FNavPathQueryDelegate ResultDelegate;
+	};
+	// keyed by ticket. Results for tickets no longer in here were cancelled and are dropped
+	TMap<uint32, FInFlightPathRequest> InFlightRequests;
+	// recycled selection buffers
+	TArray<float> EffectivePriorities;
+	TArray<int32> DispatchOrder;
+	uint32 NextTicket = 1;
+	int32 MaxDispatchPerFrame = 8;
+	float AverageWaitTime = 0.f;
+	// priority gained per second spent waiting, a request waits at most ~2s before it beats a fresh top priority one
+	const float AGING_RATE = .5f;
+	// agents further than this from the camera get the lowest distance priority
+	const float CAM_DIST_MAX = 20000.f;
+
+	float ScoreAgent(AActor* Agent) const;
+	void OnPathResult(uint32 QueryID, ENavigationQueryResult::Type Result, FNavPathSharedPtr Path, uint32 Ticket);
+};
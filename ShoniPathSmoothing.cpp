@@ -0,0 +1,208 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShoniPathSmoothing.h"
+#include "NavMesh/RecastNavMesh.h"
+#include "Algo/Count.h"
+
+namespace
+{
+	// link points have to be walked exactly, as do the points either side of one
+	FORCEINLINE bool IsLinkPoint(const FNavPathPoint& Point)
+	{
+		return FNavMeshNodeFlags(Point.Flags).IsNavLink();
+	}
+
+	FORCEINLINE bool CanMoveCorner(const TArray<FNavPathPoint>& Points, int32 Index)
+	{
+		return Index > 0 && Index < Points.Num() - 1 && !IsLinkPoint(Points[Index - 1]) && !IsLinkPoint(Points[Index]);
+	}
+
+	bool ProjectCorner(const ARecastNavMesh& NavMesh, const FSharedConstNavQueryFilter& QueryFilter, const FVector& Location, const FNavPathPoint& Corner, FNavPathPoint& OutPoint)
+	{
+		FNavLocation Projected;
+		if (!NavMesh.ProjectPoint(Location, Projected, NavMesh.GetDefaultQueryExtent(), QueryFilter)) return false;
+		OutPoint = Corner;
+		OutPoint.Location = Projected.Location;
+		OutPoint.NodeRef = Projected.NodeRef;
+		return true;
+	}
+}
+
+UShoniPathSmoother* UShoniPathSmoother::Get(const UWorld* World)
+{
+	return World ? World->GetSubsystem<UShoniPathSmoother>() : nullptr;
+}
+
+bool UShoniPathSmoother::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld() && Super::ShouldCreateSubsystem(Outer);
+}
+
+bool UShoniPathSmoother::Smooth(const FNavPathSharedPtr& InPath, uint32 AgentKey)
+{
+	check(IsInGameThread());
+	const ARecastNavMesh* NavMesh = InPath.IsValid() ? Cast<ARecastNavMesh>(InPath->GetNavigationDataUsed()) : nullptr;
+	if (!NavMesh || InPath->GetPathPoints().Num() < 3) return false;
+
+	TArray<FNavPathPoint>& Points = InPath->GetPathPoints();
+	// counted as found, even unsmoothed, string-pulling only ever drops corners so the agent's own share stays exact
+	RegisterCorners(AgentKey, Points);
+
+	if (BudgetFrame != GFrameCounter)
+	{
+		BudgetFrame = GFrameCounter;
+		FrameSmoothMs = 0.0;
+	}
+	if (FrameSmoothMs >= MAX_SMOOTH_MS) return false;
+
+	// a handful of raycasts per corner, cheaper than waiting a frame for the worker and its build lock
+	const double StartTime = FPlatformTime::Seconds();
+	const FSharedConstNavQueryFilter QueryFilter = InPath->GetFilter().IsValid() ? InPath->GetFilter() : NavMesh->GetDefaultQueryFilter();
+	SmoothPoints(*NavMesh, QueryFilter, Points, &CornerUseCounts, AgentCorners[AgentKey], AgentKey);
+	FrameSmoothMs += (FPlatformTime::Seconds() - StartTime) * 1000.0;
+	return true;
+}
+
+void UShoniPathSmoother::RegisterCorners(uint32 AgentKey, const TArray<FNavPathPoint>& Points)
+{
+	ReleaseAgent(AgentKey);
+	TArray<NavNodeRef>& Corners = AgentCorners.Add(AgentKey);
+	Corners.Reserve(Points.Num() - 2);
+	for (int32 i = 1; i < Points.Num() - 1; ++i)
+	{
+		if (Points[i].NodeRef == INVALID_NAVNODEREF) continue;
+		Corners.Add(Points[i].NodeRef);
+		++CornerUseCounts.FindOrAdd(Points[i].NodeRef);
+	}
+}
+
+void UShoniPathSmoother::ReleaseAgent(uint32 AgentKey)
+{
+	TArray<NavNodeRef> Corners;
+	if (!AgentCorners.RemoveAndCopyValue(AgentKey, Corners)) return;
+	for (NavNodeRef Poly : Corners)
+	{
+		int32* Use = CornerUseCounts.Find(Poly);
+		if (Use && --(*Use) <= 0)
+		{
+			CornerUseCounts.Remove(Poly);
+		}
+	}
+}
+
+void UShoniPathSmoother::SmoothPoints(const ARecastNavMesh& NavMesh, const FSharedConstNavQueryFilter& QueryFilter, TArray<FNavPathPoint>& Points, const TMap<NavNodeRef, int32>* CornerUse, TArrayView<const NavNodeRef> OwnCorners, uint32 AgentKey)
+{
+	StringPull(NavMesh, QueryFilter, Points);
+	if (CornerUse && CornerUse->Num())
+	{
+		OffsetLanes(NavMesh, QueryFilter, Points, *CornerUse, OwnCorners, AgentKey);
+	}
+	// last, so lanes are rounded off too
+	RoundCorners(NavMesh, QueryFilter, Points);
+}
+
+void UShoniPathSmoother::StringPull(const ARecastNavMesh& NavMesh, const FSharedConstNavQueryFilter& QueryFilter, TArray<FNavPathPoint>& Points)
+{
+	// cache hits, flow field funnels and spliced paths can all carry corners the agent can see past
+	TArray<FNavPathPoint> Pulled;
+	Pulled.Reserve(Points.Num());
+	Pulled.Add(Points[0]);
+	FVector HitLocation;
+	int32 Anchor = 0;
+	while (Anchor < Points.Num() - 1)
+	{
+		int32 Next = Anchor + 1;
+		if (!IsLinkPoint(Points[Anchor]))
+		{
+			for (int32 Candidate = Anchor + 2; Candidate < Points.Num() && Candidate <= Anchor + PULL_LOOKAHEAD; ++Candidate)
+			{
+				if (IsLinkPoint(Points[Candidate - 1]) || NavMesh.Raycast(Points[Anchor].Location, Points[Candidate].Location, HitLocation, QueryFilter)) break;
+				Next = Candidate;
+			}
+		}
+		Pulled.Add(Points[Next]);
+		Anchor = Next;
+	}
+	Points = MoveTemp(Pulled);
+}
+
+void UShoniPathSmoother::OffsetLanes(const ARecastNavMesh& NavMesh, const FSharedConstNavQueryFilter& QueryFilter, TArray<FNavPathPoint>& Points, const TMap<NavNodeRef, int32>& CornerUse, TArrayView<const NavNodeRef> OwnCorners, uint32 AgentKey)
+{
+	FVector HitLocation;
+	for (int32 i = 1; i < Points.Num() - 1; ++i)
+	{
+		const int32* Use = CornerUse.Find(Points[i].NodeRef);
+		if (!Use || !CanMoveCorner(Points, i)) continue;
+		// the agent's own path is counted too, it shouldn't make room for itself
+		const int32 NumOthers = *Use - Algo::Count(OwnCorners, Points[i].NodeRef);
+		if (NumOthers <= 0) continue;
+		// lane 0 is the tight line round the corner, the agent's key spreads sharers over the rest
+		const int32 NumLanes = FMath::Min(NumOthers + 1, MAX_LANES);
+		const int32 Lane = AgentKey % NumLanes;
+		if (Lane == 0) continue;
+
+		// the obstacle is on the inside of the turn, so lanes go outwards along the bisector
+		const FVector In = (Points[i].Location - Points[i - 1].Location).GetSafeNormal2D();
+		const FVector Out = (Points[i + 1].Location - Points[i].Location).GetSafeNormal2D();
+		FVector Outward = (In - Out).GetSafeNormal2D();
+		if (Outward.IsNearlyZero())
+		{
+			Outward = FVector(-In.Y, In.X, 0.f);
+		}
+		const FVector Target = Points[i].Location + Outward * (Lane * LANE_WIDTH);
+		FNavPathPoint Moved;
+		if (NavMesh.Raycast(Points[i].Location, Target, HitLocation, QueryFilter)
+			|| !ProjectCorner(NavMesh, QueryFilter, Target, Points[i], Moved)
+			|| NavMesh.Raycast(Points[i - 1].Location, Moved.Location, HitLocation, QueryFilter)
+			|| NavMesh.Raycast(Moved.Location, Points[i + 1].Location, HitLocation, QueryFilter))
+		{
+			continue;
+		}
+		Points[i] = Moved;
+	}
+}
+
+void UShoniPathSmoother::RoundCorners(const ARecastNavMesh& NavMesh, const FSharedConstNavQueryFilter& QueryFilter, TArray<FNavPathPoint>& Points)
+{
+	// each rounded corner becomes entry, apex and exit points on a quadratic curve through the old corner's legs
+	TArray<FNavPathPoint> Rounded;
+	Rounded.Reserve(Points.Num() * 3);
+	Rounded.Add(Points[0]);
+	FVector HitLocation;
+	for (int32 i = 1; i < Points.Num() - 1; ++i)
+	{
+		const FNavPathPoint& Corner = Points[i];
+		// measured from the previous rounded exit, which sits on this corner's incoming leg
+		const FVector InLeg = Corner.Location - Rounded.Last().Location;
+		const FVector OutLeg = Points[i + 1].Location - Corner.Location;
+		const float InLength = InLeg.Size();
+		const float OutLength = OutLeg.Size();
+		if (!CanMoveCorner(Points, i) || InLength < KINDA_SMALL_NUMBER || OutLength < KINDA_SMALL_NUMBER
+			|| (InLeg.GetSafeNormal2D() | OutLeg.GetSafeNormal2D()) > ROUND_MIN_COS)
+		{
+			Rounded.Add(Corner);
+			continue;
+		}
+
+		// under half of each leg, so neighbouring roundings never overlap
+		const float Distance = FMath::Min3(ROUND_DISTANCE, InLength * .45f, OutLength * .45f);
+		const FVector Entry = Corner.Location - InLeg / InLength * Distance;
+		const FVector Exit = Corner.Location + OutLeg / OutLength * Distance;
+		FNavPathPoint EntryPoint, ApexPoint, ExitPoint;
+		if (!ProjectCorner(NavMesh, QueryFilter, Entry, Corner, EntryPoint)
+			|| !ProjectCorner(NavMesh, QueryFilter, Entry * .25f + Corner.Location * .5f + Exit * .25f, Corner, ApexPoint)
+			|| !ProjectCorner(NavMesh, QueryFilter, Exit, Corner, ExitPoint)
+			|| NavMesh.Raycast(EntryPoint.Location, ApexPoint.Location, HitLocation, QueryFilter)
+			|| NavMesh.Raycast(ApexPoint.Location, ExitPoint.Location, HitLocation, QueryFilter))
+		{
+			Rounded.Add(Corner);
+			continue;
+		}
+		Rounded.Add(EntryPoint);
+		Rounded.Add(ApexPoint);
+		Rounded.Add(ExitPoint);
+	}
+	Rounded.Add(Points.Last());
+	Points = MoveTemp(Rounded);
+}
@@ -0,0 +1,60 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "NavigationData.h"
+#include "ShoniPathSmoothing.generated.h"
+
+class ARecastNavMesh;
+
+/* Post-processes found paths before they are followed: string-pulls corners the search left in, spreads agents
+ * that share a corner across lanes and rounds off sharp turns, so crowds stop queueing on the same navmesh vertex and RVO
+ * has less to untangle. The corridor is left alone, so the navmesh still invalidates the path as before */
+UCLASS()
+class SHONIISLAND_API UShoniPathSmoother : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UShoniPathSmoother* Get(const UWorld* World);
+
+	/* Game thread only. Smooths the path's points in place, false and the path left as it is if it has no corners to smooth
+	 * or this frame's MAX_SMOOTH_MS is used up.
+	 * AgentKey picks the agent's lane and counts its corners towards the lane density others see */
+	bool Smooth(const FNavPathSharedPtr& InPath, uint32 AgentKey);
+	/* Game thread only. Stops counting the agent's corners, for when it stops moving */
+	void ReleaseAgent(uint32 AgentKey);
+
+	/* Only reads the navmesh. CornerUse is the number of agents whose paths turn at each poly, OwnCorners the
+	 * agent's own share of it, so lanes are only spread over the number of other agents */
+	static void SmoothPoints(const ARecastNavMesh& NavMesh, const FSharedConstNavQueryFilter& QueryFilter, TArray<FNavPathPoint>& Points, const TMap<NavNodeRef, int32>* CornerUse, TArrayView<const NavNodeRef> OwnCorners, uint32 AgentKey);
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	// corners further along than this aren't tried when string-pulling
+	static constexpr int32 PULL_LOOKAHEAD = 4;
+	// lateral spacing between lanes, about an agent's width
+	static constexpr float LANE_WIDTH = 60.f;
+	static constexpr int32 MAX_LANES = 4;
+	// turns sharper than acos of this get rounded
+	static constexpr float ROUND_MIN_COS = .87f;
+	// how far back along each leg a rounded turn starts
+	static constexpr float ROUND_DISTANCE = 120.f;
+	// smoothing time per frame, paths found after it's spent are followed as they are
+	static constexpr double MAX_SMOOTH_MS = 1.0;
+
+private:
+	static void StringPull(const ARecastNavMesh& NavMesh, const FSharedConstNavQueryFilter& QueryFilter, TArray<FNavPathPoint>& Points);
+	static void OffsetLanes(const ARecastNavMesh& NavMesh, const FSharedConstNavQueryFilter& QueryFilter, TArray<FNavPathPoint>& Points, const TMap<NavNodeRef, int32>& CornerUse, TArrayView<const NavNodeRef> OwnCorners, uint32 AgentKey);
+	static void RoundCorners(const ARecastNavMesh& NavMesh, const FSharedConstNavQueryFilter& QueryFilter, TArray<FNavPathPoint>& Points);
+
+	void RegisterCorners(uint32 AgentKey, const TArray<FNavPathPoint>& Points);
+
+	// agent -> polys of its current path's interior corners
+	TMap<uint32, TArray<NavNodeRef>> AgentCorners;
+	TMap<NavNodeRef, int32> CornerUseCounts;
+	uint64 BudgetFrame = 0;
+	double FrameSmoothMs = 0.0;
+};
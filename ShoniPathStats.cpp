@@ -0,0 +1,211 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShoniPathStats.h"
+#include "ShoniPathScheduler.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogShoniPathStats, Log, All);
+
+DECLARE_STATS_GROUP(TEXT("ShoniPathing"), STATGROUP_ShoniPathing, STATCAT_Advanced);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queries issued"), STAT_ShoniPath_Requests, STATGROUP_ShoniPathing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Paths delivered"), STAT_ShoniPath_Results, STATGROUP_ShoniPathing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Failed paths"), STAT_ShoniPath_Failures, STATGROUP_ShoniPathing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Served without a search"), STAT_ShoniPath_Unqueried, STATGROUP_ShoniPathing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queries in flight"), STAT_ShoniPath_InFlight, STATGROUP_ShoniPathing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Scheduler queue depth"), STAT_ShoniPath_QueueDepth, STATGROUP_ShoniPathing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Move retries"), STAT_ShoniPath_MoveRetries, STATGROUP_ShoniPathing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Repath retries"), STAT_ShoniPath_RepathRetries, STATGROUP_ShoniPathing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Repaths"), STAT_ShoniPath_Repaths, STATGROUP_ShoniPathing);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Worst latency ms"), STAT_ShoniPath_MaxLatency, STATGROUP_ShoniPathing);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Avg latency ms (all time)"), STAT_ShoniPath_AvgLatency, STATGROUP_ShoniPathing);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("p95 latency ms (all time)"), STAT_ShoniPath_P95Latency, STATGROUP_ShoniPathing);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Avg path length m (all time)"), STAT_ShoniPath_AvgLength, STATGROUP_ShoniPathing);
+
+static FAutoConsoleCommandWithWorldAndArgs ShoniPathingDumpTraceCommand(
+	TEXT("Shoni.Pathing.DumpTrace"),
+	TEXT("Writes the recent per-frame pathing trace and latency/length histograms to CSV. Optional arg: file path (defaults to the profiling dir)"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+		{
+			const UShoniPathStats* Stats = UShoniPathStats::Get(World);
+			if (!Stats)
+			{
+				UE_LOG(LogShoniPathStats, Warning, TEXT("No path stats for this world"));
+				return;
+			}
+			const FString FilePath = Args.Num() ? Args[0] : FPaths::ProfilingDir() / TEXT("ShoniPathing") / FString::Printf(TEXT("%s_%s.csv"), *World->GetName(), *FDateTime::Now().ToString());
+			if (Stats->DumpTraceToCSV(FilePath))
+			{
+				UE_LOG(LogShoniPathStats, Log, TEXT("Pathing trace written to %s"), *FilePath);
+			}
+		}));
+
+void FShoniHistogram::Init(std::initializer_list<float> InBounds)
+{
+	Bounds = InBounds;
+	Counts.Init(0, Bounds.Num() + 1);
+	NumSamples = 0;
+	Sum = 0.0;
+}
+
+void FShoniHistogram::Add(float Value)
+{
+	int32 Bucket = 0;
+	while (Bucket < Bounds.Num() && Value > Bounds[Bucket]) ++Bucket;
+	++Counts[Bucket];
+	++NumSamples;
+	Sum += Value;
+}
+
+void FShoniHistogram::Reset()
+{
+	for (int32& Count : Counts) Count = 0;
+	NumSamples = 0;
+	Sum = 0.0;
+}
+
+float FShoniHistogram::GetPercentile(float Fraction) const
+{
+	if (!NumSamples || !Bounds.Num()) return 0.f;
+	const int32 Target = FMath::CeilToInt(NumSamples * Fraction);
+	int32 Seen = 0;
+	for (int32 Bucket = 0; Bucket < Bounds.Num(); ++Bucket)
+	{
+		Seen += Counts[Bucket];
+		if (Seen >= Target) return Bounds[Bucket];
+	}
+	// in the open-ended bucket
+	return Bounds.Last();
+}
+
+UShoniPathStats* UShoniPathStats::Get(const UWorld* World)
+{
+	return World ? World->GetSubsystem<UShoniPathStats>() : nullptr;
+}
+
+bool UShoniPathStats::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld() && Super::ShouldCreateSubsystem(Outer);
+}
+
+void UShoniPathStats::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	// roughly doubling, a frame is ~16ms
+	LatencyMs.Init({ 1.f, 2.f, 4.f, 8.f, 16.f, 33.f, 66.f, 133.f, 250.f, 500.f, 1000.f });
+	PathLengthM.Init({ 5.f, 10.f, 25.f, 50.f, 100.f, 250.f, 500.f, 1000.f });
+	RepathsPerTask.Init({ 0.f, 1.f, 2.f, 4.f, 8.f, 16.f, 32.f });
+	TraceBuffer.Reserve(TRACE_CAPACITY);
+}
+
+TStatId UShoniPathStats::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShoniPathStats, STATGROUP_Tickables);
+}
+
+void UShoniPathStats::RecordPathResult(double RequestTime, double ResultTime, double MoveTime, ENavigationQueryResult::Type Result, const FNavigationPath* Path, bool bQueried)
+{
+	++Frame.NumResults;
+	if (Result != ENavigationQueryResult::Success)
+	{
+		++Frame.NumFailures;
+	}
+	if (!bQueried)
+	{
+		++Frame.NumUnqueried;
+		return;
+	}
+
+	const float Latency = (ResultTime - RequestTime) * 1000.0;
+	const float Handoff = (MoveTime - ResultTime) * 1000.0;
+	LatencyMs.Add(Latency);
+	Frame.SumLatencyMs += Latency;
+	Frame.MaxLatencyMs = FMath::Max(Frame.MaxLatencyMs, Latency);
+	Frame.MaxHandoffMs = FMath::Max(Frame.MaxHandoffMs, Handoff);
+	if (Path && Result == ENavigationQueryResult::Success)
+	{
+		PathLengthM.Add(Path->GetLength() * .01f);
+	}
+}
+
+void UShoniPathStats::RecordRetry(bool bRepath)
+{
+	if (bRepath)
+	{
+		++Frame.NumRepathRetries;
+	}
+	else
+	{
+		++Frame.NumMoveRetries;
+	}
+}
+
+void UShoniPathStats::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+	Frame.Time = GetWorld()->GetTimeSeconds();
+	Frame.FrameMs = DeltaTime * 1000.f;
+	Frame.NumInFlight = NumInFlight;
+	const UShoniPathScheduler* Scheduler = UShoniPathScheduler::Get(GetWorld());
+	Frame.QueueDepth = Scheduler ? Scheduler->GetQueueDepth() : 0;
+
+	SET_DWORD_STAT(STAT_ShoniPath_Requests, Frame.NumRequests);
+	SET_DWORD_STAT(STAT_ShoniPath_Results, Frame.NumResults);
+	SET_DWORD_STAT(STAT_ShoniPath_Failures, Frame.NumFailures);
+	SET_DWORD_STAT(STAT_ShoniPath_Unqueried, Frame.NumUnqueried);
+	SET_DWORD_STAT(STAT_ShoniPath_InFlight, Frame.NumInFlight);
+	SET_DWORD_STAT(STAT_ShoniPath_QueueDepth, Frame.QueueDepth);
+	SET_DWORD_STAT(STAT_ShoniPath_MoveRetries, Frame.NumMoveRetries);
+	SET_DWORD_STAT(STAT_ShoniPath_RepathRetries, Frame.NumRepathRetries);
+	SET_DWORD_STAT(STAT_ShoniPath_Repaths, Frame.NumRepaths);
+	SET_FLOAT_STAT(STAT_ShoniPath_MaxLatency, Frame.MaxLatencyMs);
+	SET_FLOAT_STAT(STAT_ShoniPath_AvgLatency, LatencyMs.GetAverage());
+	SET_FLOAT_STAT(STAT_ShoniPath_P95Latency, LatencyMs.GetPercentile(.95f));
+	SET_FLOAT_STAT(STAT_ShoniPath_AvgLength, PathLengthM.GetAverage());
+
+	// quiet frames are still recorded, gaps would hide how long a flood took to drain
+	if (TraceBuffer.Num() < TRACE_CAPACITY)
+	{
+		TraceBuffer.Add(Frame);
+	}
+	else
+	{
+		TraceBuffer[TraceHead] = Frame;
+	}
+	TraceHead = (TraceHead + 1) % TRACE_CAPACITY;
+	Frame = FFrameSample();
+}
+
+bool UShoniPathStats::DumpTraceToCSV(const FString& FilePath) const
+{
+	if (TraceBuffer.IsEmpty()) return false;
+
+	FString Csv = TEXT("Time,FrameMs,Requests,Results,Failures,Unqueried,InFlight,QueueDepth,MoveRetries,RepathRetries,Repaths,AvgLatencyMs,MaxLatencyMs,MaxHandoffMs\n");
+	// oldest first: once the ring has wrapped the oldest sample sits at the head
+	const int32 Start = TraceBuffer.Num() < TRACE_CAPACITY ? 0 : TraceHead;
+	for (int32 i = 0; i < TraceBuffer.Num(); ++i)
+	{
+		const FFrameSample& Sample = TraceBuffer[(Start + i) % TraceBuffer.Num()];
+		const int32 NumQueried = Sample.NumResults - Sample.NumUnqueried;
+		Csv += FString::Printf(TEXT("%.3f,%.2f,%i,%i,%i,%i,%i,%i,%i,%i,%i,%.3f,%.3f,%.3f\n"),
+			Sample.Time, Sample.FrameMs, Sample.NumRequests, Sample.NumResults, Sample.NumFailures, Sample.NumUnqueried, Sample.NumInFlight, Sample.QueueDepth,
+			Sample.NumMoveRetries, Sample.NumRepathRetries, Sample.NumRepaths, NumQueried > 0 ? Sample.SumLatencyMs / NumQueried : 0.0, Sample.MaxLatencyMs, Sample.MaxHandoffMs);
+	}
+	if (!FFileHelper::SaveStringToFile(Csv, *FilePath)) return false;
+
+	FString HistogramCsv = TEXT("Histogram,UpperBound,Count\n");
+	auto AppendHistogram = [&HistogramCsv](const TCHAR* Name, const FShoniHistogram& Histogram)
+	{
+		for (int32 Bucket = 0; Bucket < Histogram.Counts.Num(); ++Bucket)
+		{
+			const FString Bound = Bucket < Histogram.Bounds.Num() ? FString::SanitizeFloat(Histogram.Bounds[Bucket]) : TEXT("inf");
+			HistogramCsv += FString::Printf(TEXT("%s,%s,%i\n"), Name, *Bound, Histogram.Counts[Bucket]);
+		}
+	};
+	AppendHistogram(TEXT("LatencyMs"), LatencyMs);
+	AppendHistogram(TEXT("PathLengthM"), PathLengthM);
+	AppendHistogram(TEXT("RepathsPerTask"), RepathsPerTask);
+	return FFileHelper::SaveStringToFile(HistogramCsv, *(FPaths::GetBaseFilename(FilePath, false) + TEXT("_histograms.csv")));
+}
@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "NavigationData.h"
+#include "ShoniPathStats.generated.h"
+
+/* Fixed bucket histogram, bucket i counts values up to Bounds[i], the last bucket everything above */
+struct FShoniHistogram
+{
+	TArray<float> Bounds;
+	TArray<int32> Counts;
+	int32 NumSamples = 0;
+	double Sum = 0.0;
+
+	void Init(std::initializer_list<float> InBounds);
+	void Add(float Value);
+	void Reset();
+	float GetAverage() const { return NumSamples ? Sum / NumSamples : 0.f; }
+	/* Upper bound of the bucket the given fraction of samples falls under, approximate by bucket width */
+	float GetPercentile(float Fraction) const;
+};
+
+/* Pathfinding latency and throughput for every AsyncMoveTo in the world. Per-frame counters show up under
+ * stat ShoniPathing, the last TRACE_CAPACITY frames are kept for Shoni.Pathing.DumpTrace to line path floods up with hitches */
+UCLASS()
+class SHONIISLAND_API UShoniPathStats : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UShoniPathStats* Get(const UWorld* World);
+
+	/* A query went out to the scheduler or the navmesh workers */
+	void RecordQueryStarted() { ++NumInFlight; ++Frame.NumRequests; ++NumRequestsTotal; }
+	/* A query came back or was aborted */
+	void RecordQueryEnded() { NumInFlight = FMath::Max(NumInFlight - 1, 0); }
+	/* Seconds are FPlatformTime. RequestTime is PerformMove, ResultTime the result landing, MoveTime the path being handed to path following.
+	 * bQueried is false for paths served without a search (cache, flow field, straight line) */
+	void RecordPathResult(double RequestTime, double ResultTime, double MoveTime, ENavigationQueryResult::Type Result, const FNavigationPath* Path, bool bQueried);
+	/* ConditionalPerformMove (bRepath false) or ConditionalUpdatePath (true) had to postpone */
+	void RecordRetry(bool bRepath);
+	void RecordRepath() { ++Frame.NumRepaths; }
+	/* Repaths the task ran over its lifetime */
+	void RecordTaskFinished(int32 NumRepaths) { RepathsPerTask.Add(NumRepaths); }
+
+	const FShoniHistogram& GetLatencyHistogram() const { return LatencyMs; }
+	const FShoniHistogram& GetPathLengthHistogram() const { return PathLengthM; }
+	int32 GetNumInFlight() const { return NumInFlight; }
+	int64 GetNumRequestsTotal() const { return NumRequestsTotal; }
+	/* Writes the per-frame trace oldest first, and the histograms next to it with a _histograms suffix */
+	bool DumpTraceToCSV(const FString& FilePath) const;
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+private:
+	struct FFrameSample
+	{
+		double Time = 0.0;
+		float FrameMs = 0.f;
+		int32 NumRequests = 0;
+		int32 NumResults = 0;
+		int32 NumFailures = 0;
+		int32 NumUnqueried = 0;
+		int32 NumInFlight = 0;
+		int32 QueueDepth = 0;
+		int32 NumMoveRetries = 0;
+		int32 NumRepathRetries = 0;
+		int32 NumRepaths = 0;
+		float MaxLatencyMs = 0.f;
+		double SumLatencyMs = 0.0;
+		float MaxHandoffMs = 0.f;
+	};
+	FFrameSample Frame;
+	int32 NumInFlight = 0;
+	int64 NumRequestsTotal = 0;
+	// totals since the world started, histograms only count searched paths
+	FShoniHistogram LatencyMs;
+	FShoniHistogram PathLengthM;
+	FShoniHistogram RepathsPerTask;
+
+	static constexpr int32 TRACE_CAPACITY = 4096;
+	TArray<FFrameSample> TraceBuffer;
+	int32 TraceHead = 0;
+};
@@ -0,0 +1,338 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ShoniSignificanceManager.h"
+#include "Camera/CameraActor.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+#if !UE_BUILD_SHIPPING
+
+DEFINE_LOG_CATEGORY_STATIC(LogShoniSignificanceBenchmark, Log, All);
+
+/* Headless throughput benchmark for the significance manager. Bare scene components stand in for registered actors so
+ * 200k can be pushed through the manager's own pass (gather, spatial culling, score, budget, change lists, apply) without
+ * spawning anything but the camera. The components implement no interface, so callbacks are counted but cost nothing.
+ * Each pass drains the process-wide registration queues like any other, so it refuses to run, or stops, while live
+ * registrations are waiting in them.
+ * Run with: Shoni.Significance.Benchmark [NumObjects] [Frames] [orbit|fly|teleport|all] [full|culled] [CsvPath] */
+struct FShoniSignificanceBenchmark
+{
+	enum ECameraPath
+	{
+		CP_Orbit,
+		CP_FlyThrough,
+		CP_Teleport,
+		CP_MAX
+	};
+
+	struct FSyntheticObject
+	{
+		USceneComponent* Component;
+		FSignificanceHandle Handle;
+		// zero for static props
+		FVector Velocity;
+		float BoundsRadius;
+	};
+
+	struct FFrameSample
+	{
+		float GatherMs = 0.f;
+		// scoring, budgets and change lists, all on the worker
+		float ScoreMs = 0.f;
+		float ApplyMs = 0.f;
+		// gather to apply including the hops between threads
+		float PassMs = 0.f;
+		int32 NumScored = 0;
+		int32 NumSignificant = 0;
+		int32 NumCallbacks = 0;
+		int32 Transitions[SIG_MAX] = {};
+	};
+
+	static constexpr int32 MIN_OBJECTS = 1000;
+	static constexpr int32 MAX_OBJECTS = 200000;
+	// square world the objects are scattered over, a few camera ranges across
+	static constexpr float WORLD_HALF_EXTENT = 100000.f;
+	static constexpr float MOVER_FRACTION = .2f;
+	static constexpr float MOVER_SPEED = 300.f;
+	// frames between cuts on the teleport path
+	static constexpr int32 TELEPORT_INTERVAL = 10;
+
+	static const TCHAR* GetPathName(ECameraPath Path)
+	{
+		switch (Path)
+		{
+		case CP_Orbit:		return TEXT("orbit");
+		case CP_FlyThrough:	return TEXT("fly");
+		case CP_Teleport:	return TEXT("teleport");
+		default:			return TEXT("unknown");
+		}
+	}
+
+	/* The benchmark manager's passes would route these, and spend their time doing it */
+	static bool HasPendingRegistrations()
+	{
+		return UShoniSignificanceManager::NumQueuedAdds.load(std::memory_order_relaxed) || UShoniSignificanceManager::NumQueuedRemoves.load(std::memory_order_relaxed)
+			|| UShoniSignificanceManager::UnroutedAdds.Num() || UShoniSignificanceManager::ObjectsToRemove.Num();
+	}
+
+	static void SetLocation(FSyntheticObject& Obj, const FVector& Location)
+	{
+		Obj.Component->SetWorldLocation(Location);
+		// a bare scene component's bounds collapse to a point whenever it moves
+		Obj.Component->Bounds.SphereRadius = Obj.BoundsRadius;
+	}
+
+	/* Registers the objects straight into the manager the way ApplyContainerChanges would after routing, the components
+	 * have no world to be routed by */
+	static void SpawnObjects(UShoniSignificanceManager& Manager, TArray<FSyntheticObject>& Objects, int32 NumObjects, FRandomStream& Rand)
+	{
+		Objects.SetNum(NumObjects);
+		for (int32 i = 0; i < NumObjects; ++i)
+		{
+			FSyntheticObject& Obj = Objects[i];
+			// rooted, the manager only holds weak pointers and the passes below pump the game thread
+			Obj.Component = NewObject<USceneComponent>(GetTransientPackage());
+			Obj.Component->AddToRoot();
+			Obj.Velocity = Rand.FRand() < MOVER_FRACTION ? Rand.GetUnitVector().GetSafeNormal2D() * MOVER_SPEED : FVector::ZeroVector;
+			Obj.BoundsRadius = Rand.FRandRange(25.f, 500.f);
+			SetLocation(Obj, FVector(Rand.FRandRange(-WORLD_HALF_EXTENT, WORLD_HALF_EXTENT), Rand.FRandRange(-WORLD_HALF_EXTENT, WORLD_HALF_EXTENT), 0.f));
+
+			FSignificanceSlot* Slot = UShoniSignificanceManager::ClaimSlot();
+			if (!Slot)
+			{
+				Obj.Component->RemoveFromRoot();
+				Objects.SetNum(i);
+				break;
+			}
+			Obj.Handle = { Slot->SlotIndex, Slot->Generation.load(std::memory_order_acquire) };
+			Slot->Key = Obj.Component;
+			Slot->Owner = &Manager;
+			// round robin keeps every tag populated at any count
+			Manager.ElementsToAdd.Add({ Obj.Handle, Obj.Component, (ESignificanceTag)(i % SIG_MAX), Rand.FRandRange(.25f, 1.f) });
+		}
+		Manager.ApplyContainerChanges();
+	}
+
+	static void DestroyObjects(UShoniSignificanceManager& Manager, TArray<FSyntheticObject>& Objects)
+	{
+		for (const FSyntheticObject& Obj : Objects)
+		{
+			Manager.ElementsToRemove.Add(Obj.Handle);
+			Obj.Component->RemoveFromRoot();
+			Obj.Component->MarkAsGarbage();
+		}
+		Manager.ApplyContainerChanges();
+		Objects.Reset();
+	}
+
+	static void SampleCamera(ECameraPath Path, int32 Frame, float Time, FRandomStream& Rand, FVector& OutLocation, FVector& OutDirection)
+	{
+		switch (Path)
+		{
+		case CP_Orbit:
+		{
+			// circle the middle of the world looking inwards
+			const float Angle = Time * .2f;
+			OutLocation = FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.f) * (WORLD_HALF_EXTENT * .5f) + FVector(0.f, 0.f, 2000.f);
+			OutDirection = (-OutLocation).GetSafeNormal2D();
+			break;
+		}
+		case CP_FlyThrough:
+		{
+			// corner to corner at a fast traversal speed, wrapping round
+			const float Alpha = FMath::Fmod(Time * 5000.f, WORLD_HALF_EXTENT * 4.f) / (WORLD_HALF_EXTENT * 4.f);
+			OutLocation = FMath::Lerp(FVector(-WORLD_HALF_EXTENT, -WORLD_HALF_EXTENT, 2000.f), FVector(WORLD_HALF_EXTENT, WORLD_HALF_EXTENT, 2000.f), Alpha);
+			OutDirection = FVector(1.f, 1.f, 0.f).GetSafeNormal();
+			break;
+		}
+		case CP_Teleport:
+		{
+			// only cut every few frames so transitions settle in between
+			if (Frame % TELEPORT_INTERVAL == 0)
+			{
+				OutLocation = FVector(Rand.FRandRange(-WORLD_HALF_EXTENT, WORLD_HALF_EXTENT), Rand.FRandRange(-WORLD_HALF_EXTENT, WORLD_HALF_EXTENT), 2000.f);
+				OutDirection = Rand.GetUnitVector().GetSafeNormal2D();
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	/* False if live registrations showed up mid-run, OutSamples then only holds the passes before them */
+	static bool RunPath(UShoniSignificanceManager& Manager, AActor& Camera, ECameraPath Path, int32 NumObjects, int32 NumFrames, TArray<FFrameSample>& OutSamples)
+	{
+		FRandomStream Rand(NumObjects);
+		TArray<FSyntheticObject> Objects;
+		// empty grid and active set, nothing carried over from the previous path
+		Manager.SetSpatialCulling(Manager.bSpatialCulling, Manager.SpatialCellSize);
+		SpawnObjects(Manager, Objects, NumObjects, Rand);
+
+		const float Interval = Manager.INTERVAL;
+		FVector CameraLocation = FVector::ZeroVector;
+		FVector CameraDirection = FVector::ForwardVector;
+		Manager.ViewStates.Reset();
+		Manager.AddView(&Camera);
+		Manager.bFirstPassComplete = false;
+		OutSamples.Reset(NumFrames);
+
+		bool bClean = true;
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			// the previous pass pumped the game thread, anything could have registered meanwhile
+			if (HasPendingRegistrations())
+			{
+				bClean = false;
+				break;
+			}
+			const float Time = Frame * Interval;
+			FFrameSample& Sample = OutSamples.AddDefaulted_GetRef();
+
+			// movers step between passes like they would in game, not timed
+			for (FSyntheticObject& Obj : Objects)
+			{
+				if (!Obj.Velocity.IsZero()) SetLocation(Obj, Obj.Component->GetComponentLocation() + Obj.Velocity * Interval);
+			}
+			SampleCamera(Path, Frame, Time, Rand, CameraLocation, CameraDirection);
+			Camera.SetActorLocationAndRotation(CameraLocation, CameraDirection.Rotation());
+			// the world clock stands still while this runs, so pretend a pass interval went by for the view's velocity
+			if (Frame > 0)
+			{
+				Manager.ViewStates[0].LastSampleTime = Manager.OwningWorld->GetTimeSeconds() - Interval;
+			}
+
+			// the manager's own pass, waited out on the game thread so its continuation can run
+			const double PassStart = FPlatformTime::Seconds();
+			Manager.CalculateSignificance();
+			while (Manager.bAsyncOperationInProgress)
+			{
+				FTaskGraphInterface::Get().ProcessThreadUntilIdle(ENamedThreads::GameThread);
+			}
+			Sample.PassMs = (FPlatformTime::Seconds() - PassStart) * 1000.0;
+
+			const UShoniSignificanceManager::FTraceSample& Trace = Manager.PendingTraceSample;
+			Sample.GatherMs = Trace.GatherMs;
+			Sample.ScoreMs = Trace.ScoreMs;
+			Sample.ApplyMs = Trace.ApplyMs;
+			Sample.NumScored = Manager.AsyncTransformQueue.Num();
+			Sample.NumSignificant = Trace.NumSignificant;
+			for (int32 Tag = 0; Tag < SIG_MAX; ++Tag)
+			{
+				const FSignificanceChangeList& Changes = Manager.TagChanges[Tag];
+				Sample.Transitions[Tag] = Changes.NumTransitions();
+				Sample.NumCallbacks += Changes.NumTransitions() + Changes.ValueChanged.Num();
+			}
+		}
+		DestroyObjects(Manager, Objects);
+		return bClean;
+	}
+
+	static void Run(const TArray<FString>& Args, UWorld* World)
+	{
+		const int32 NumObjects = FMath::Clamp(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 50000, MIN_OBJECTS, MAX_OBJECTS);
+		const int32 NumFrames = FMath::Max(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 300, 1);
+		const FString PathArg = Args.Num() > 2 ? Args[2] : TEXT("all");
+		if (!World)
+		{
+			UE_LOG(LogShoniSignificanceBenchmark, Warning, TEXT("Needs a world to place the camera in"));
+			return;
+		}
+		if (HasPendingRegistrations())
+		{
+			UE_LOG(LogShoniSignificanceBenchmark, Warning, TEXT("Registrations are still queued for the live managers, run again once they've drained"));
+			return;
+		}
+
+		// transient and kept out of WorldManagers, so it is never routed any real registrations
+		UShoniSignificanceManager* Manager = NewObject<UShoniSignificanceManager>(GetTransientPackage());
+		Manager->AddToRoot();
+		Manager->OwningWorld = World;
+		Manager->bIsInited = true;
+		// benchmark against the live world's tuning when there is one
+		bool bCulled = false;
+		if (const UShoniSignificanceManager* Live = UShoniSignificanceManager::Get(World))
+		{
+			for (int32 Tag = 0; Tag < SIG_MAX; ++Tag)
+			{
+				Manager->TagConfigs[Tag] = Live->TagConfigs[Tag];
+				Manager->TagScorers[Tag] = Live->TagScorers[Tag];
+				Manager->TagFactors[Tag] = Live->TagFactors[Tag];
+			}
+			Manager->SetCameraPrediction(Live->PredictionTime, Live->PrefetchScale);
+			bCulled = Live->bSpatialCulling;
+			Manager->SpatialCellSize = Live->SpatialCellSize;
+		}
+		if (Args.Num() > 3)
+		{
+			bCulled = Args[3] == TEXT("culled");
+		}
+		Manager->SetSpatialCulling(bCulled, Manager->SpatialCellSize);
+
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.ObjectFlags |= RF_Transient;
+		ACameraActor* Camera = World->SpawnActor<ACameraActor>(SpawnParams);
+		if (!Camera)
+		{
+			UE_LOG(LogShoniSignificanceBenchmark, Warning, TEXT("Couldn't spawn the benchmark camera"));
+			Manager->bIsInited = false;
+			Manager->RemoveFromRoot();
+			Manager->MarkAsGarbage();
+			return;
+		}
+
+		FString Csv = TEXT("Path,Culling,Frame,Objects,Scored,GatherMs,ScoreMs,ApplyMs,PassMs,Significant,Callbacks,TransitionsGameplay,TransitionsRendering,TransitionsAudio,TransitionsNiagara\n");
+		const TCHAR* CullingName = bCulled ? TEXT("culled") : TEXT("full");
+		TArray<FFrameSample> Samples;
+		for (int32 Path = 0; Path < CP_MAX; ++Path)
+		{
+			const TCHAR* PathName = GetPathName((ECameraPath)Path);
+			if (PathArg != TEXT("all") && PathArg != PathName) continue;
+
+			if (!RunPath(*Manager, *Camera, (ECameraPath)Path, NumObjects, NumFrames, Samples))
+			{
+				UE_LOG(LogShoniSignificanceBenchmark, Warning, TEXT("%s: live registrations were queued after %i passes, stopping"), PathName, Samples.Num());
+				break;
+			}
+
+			double TotalMs = 0.0;
+			double WorstMs = 0.0;
+			int64 TotalTransitions = 0;
+			for (int32 Frame = 0; Frame < Samples.Num(); ++Frame)
+			{
+				const FFrameSample& S = Samples[Frame];
+				TotalMs += S.PassMs;
+				WorstMs = FMath::Max<double>(WorstMs, S.PassMs);
+				for (int32 Tag = 0; Tag < SIG_MAX; ++Tag)
+				{
+					TotalTransitions += S.Transitions[Tag];
+				}
+				Csv += FString::Printf(TEXT("%s,%s,%i,%i,%i,%.4f,%.4f,%.4f,%.4f,%i,%i,%i,%i,%i,%i\n"),
+					PathName, CullingName, Frame, NumObjects, S.NumScored, S.GatherMs, S.ScoreMs, S.ApplyMs, S.PassMs, S.NumSignificant, S.NumCallbacks,
+					S.Transitions[SIG_Gameplay], S.Transitions[SIG_Rendering], S.Transitions[SIG_Audio], S.Transitions[SIG_Niagara]);
+			}
+			UE_LOG(LogShoniSignificanceBenchmark, Display, TEXT("%s (%s): %i objects, %i passes. Avg %.3fms, worst %.3fms, %lld transitions"),
+				PathName, CullingName, NumObjects, Samples.Num(), TotalMs / Samples.Num(), WorstMs, TotalTransitions);
+		}
+		Camera->Destroy();
+		// every slot it held went back in DestroyObjects
+		Manager->bIsInited = false;
+		Manager->RemoveFromRoot();
+		Manager->MarkAsGarbage();
+
+		const FString FilePath = Args.Num() > 4 ? Args[4] : FPaths::ProfilingDir() / TEXT("ShoniSignificance") / FString::Printf(TEXT("Benchmark_%i_%s_%s.csv"), NumObjects, CullingName, *FDateTime::Now().ToString());
+		if (FFileHelper::SaveStringToFile(Csv, *FilePath))
+		{
+			UE_LOG(LogShoniSignificanceBenchmark, Display, TEXT("Benchmark written to %s"), *FilePath);
+		}
+	}
+};
+
+static FAutoConsoleCommandWithWorldAndArgs ShoniSignificanceBenchmarkCommand(
+	TEXT("Shoni.Significance.Benchmark"),
+	TEXT("Runs the significance manager over synthetic objects along scripted camera paths and writes per-phase timings to CSV. Won't run while live registrations are queued. Args: [NumObjects 1000-200000] [Frames] [orbit|fly|teleport|all] [full|culled] [CsvPath]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&FShoniSignificanceBenchmark::Run));
+
+#endif
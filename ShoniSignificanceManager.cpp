@@ -3,195 +3,908 @@
 #include "ShoniSignificanceManager.h"
 #include "../../Interfaces/SignificanceInterface.h"
 #include "../../AI/Actors/Villager.h"
+#include "Camera/CameraComponent.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Stats/Stats.h"
+#include <algorithm>
 
-TArray<FSignificanceObject> UShoniSignificanceManager::RegisteredObjects = {};
-bool UShoniSignificanceManager::bAsyncOperationInProgress = false;
-bool UShoniSignificanceManager::bRequiresUpdate = false;
-bool UShoniSignificanceManager::bDebouncePending = false;
-bool UShoniSignificanceManager::bIsInited = false;
-TArray<TPair<TWeakObjectPtr<UObject>, ESignificanceTag>> UShoniSignificanceManager::ElementsToAdd = {};
-TArray<TWeakObjectPtr<UObject>> UShoniSignificanceManager::ElementsToRemove = {};
-TMap<TObjectKey<UObject>, int32> UShoniSignificanceManager::ObjectLookupTable = {};
+std::atomic<bool> UShoniSignificanceManager::bRequiresUpdate{ false };
+TQueue<FSignificancePendingAdd, EQueueMode::Mpsc> UShoniSignificanceManager::AddQueue;
+TQueue<FSignificanceHandle, EQueueMode::Mpsc> UShoniSignificanceManager::RemoveQueue;
+TArray<FSignificancePendingAdd> UShoniSignificanceManager::DrainedAdds = {};
+TSet<FSignificanceHandle> UShoniSignificanceManager::DrainedRemoves = {};
+TArray<FSignificancePendingAdd> UShoniSignificanceManager::UnroutedAdds = {};
+TSet<TObjectKey<UObject>> UShoniSignificanceManager::ObjectsToRemove = {};
+std::atomic<FSignificanceSlot*> UShoniSignificanceManager::SlotPages[UShoniSignificanceManager::MAX_SLOT_PAGES] = {};
+std::atomic<int32> UShoniSignificanceManager::NumSlotsClaimed{ 0 };
+TLockFreePointerListLIFO<FSignificanceSlot> UShoniSignificanceManager::FreeSlots;
+TMap<TObjectKey<UObject>, FSignificanceHandle> UShoniSignificanceManager::ObjectLookupTable = {};
+TMap<TObjectKey<UWorld>, TWeakObjectPtr<UShoniSignificanceManager>> UShoniSignificanceManager::WorldManagers = {};
+
+std::atomic<int32> UShoniSignificanceManager::NumQueuedAdds{ 0 };
+std::atomic<int32> UShoniSignificanceManager::NumQueuedRemoves{ 0 };
+std::atomic<uint32> UShoniSignificanceManager::TotalRegistrations{ 0 };
+std::atomic<uint32> UShoniSignificanceManager::TotalDeregistrations{ 0 };
 
 DEFINE_LOG_CATEGORY_STATIC(LogShoniSignificance, Log, All);
 
+DECLARE_STATS_GROUP(TEXT("ShoniSignificance"), STATGROUP_ShoniSignificance, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Drain registrations"), STAT_ShoniSig_Drain, STATGROUP_ShoniSignificance);
+DECLARE_CYCLE_STAT(TEXT("Gather (GT)"), STAT_ShoniSig_Gather, STATGROUP_ShoniSignificance);
+DECLARE_CYCLE_STAT(TEXT("Score (BG)"), STAT_ShoniSig_Score, STATGROUP_ShoniSignificance);
+DECLARE_CYCLE_STAT(TEXT("Apply callbacks (GT)"), STAT_ShoniSig_Apply, STATGROUP_ShoniSignificance);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Last score pass ms (BG)"), STAT_ShoniSig_ScoreMs, STATGROUP_ShoniSignificance);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Registered objects"), STAT_ShoniSig_Registered, STATGROUP_ShoniSignificance);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Scored objects"), STAT_ShoniSig_Scored, STATGROUP_ShoniSignificance);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Significant objects"), STAT_ShoniSig_Significant, STATGROUP_ShoniSignificance);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Transitions: Gameplay"), STAT_ShoniSig_TransitionsGameplay, STATGROUP_ShoniSignificance);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Transitions: Rendering"), STAT_ShoniSig_TransitionsRendering, STATGROUP_ShoniSignificance);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Transitions: Audio"), STAT_ShoniSig_TransitionsAudio, STATGROUP_ShoniSignificance);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Transitions: Niagara"), STAT_ShoniSig_TransitionsNiagara, STATGROUP_ShoniSignificance);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Registrations/s"), STAT_ShoniSig_RegistrationRate, STATGROUP_ShoniSignificance);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Deregistrations/s"), STAT_ShoniSig_DeregistrationRate, STATGROUP_ShoniSignificance);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Add queue depth"), STAT_ShoniSig_AddQueueDepth, STATGROUP_ShoniSignificance);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Remove queue depth"), STAT_ShoniSig_RemoveQueueDepth, STATGROUP_ShoniSignificance);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Awaiting a manager"), STAT_ShoniSig_Unrouted, STATGROUP_ShoniSignificance);
+
+static FAutoConsoleCommandWithWorldAndArgs ShoniSignificanceDumpTraceCommand(
+	TEXT("Shoni.Significance.DumpTrace"),
+	TEXT("Writes the significance manager's recent pass trace to CSV. Optional arg: file path (defaults to the profiling dir)"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+		{
+			const UShoniSignificanceManager* Manager = UShoniSignificanceManager::Get(World);
+			if (!Manager)
+			{
+				UE_LOG(LogShoniSignificance, Warning, TEXT("No significance manager for this world"));
+				return;
+			}
+			const FString FilePath = Args.Num() ? Args[0] : FPaths::ProfilingDir() / TEXT("ShoniSignificance") / FString::Printf(TEXT("%s_%s.csv"), *World->GetName(), *FDateTime::Now().ToString());
+			if (Manager->DumpTraceToCSV(FilePath))
+			{
+				UE_LOG(LogShoniSignificance, Log, TEXT("Significance trace written to %s"), *FilePath);
+			}
+		}));
+
+UShoniSignificanceManager::UShoniSignificanceManager()
+{
+	for (int32 Tag = 0; Tag < SIG_MAX; ++Tag)
+	{
+		TagConfigs[Tag] = ShoniSignificance::GetDefaultTagConfig((ESignificanceTag)Tag);
+		TagScorers[Tag] = ShoniSignificance::GetDefaultScorer((ESignificanceTag)Tag);
+		TagFactors[Tag] = ShoniSignificance::GetDefaultFactors((ESignificanceTag)Tag);
+		TagRangeStart[Tag] = 0;
+		TagRangeNum[Tag] = 0;
+	}
+}
+
 void UShoniSignificanceManager::Init(AActor* Camera)
 {
-	if (Camera && Camera->GetWorld())
+	if (!Camera || !Camera->GetWorld()) return;
+
+	if (bIsInited)
+	{
+		AddView(Camera);
+		return;
+	}
+
+	UWorld* World = Camera->GetWorld();
+	TWeakObjectPtr<UShoniSignificanceManager>& Existing = WorldManagers.FindOrAdd(World);
+	if (Existing.IsValid() && Existing.Get() != this)
+	{
+		UE_LOG(LogShoniSignificance, Warning, TEXT("%s already has a significance manager, replacing it"), *World->GetName());
+	}
+	Existing = this;
+	OwningWorld = World;
+	bAsyncOperationInProgress = false;
+	bIsInited = true;
+	AddView(Camera);
+	World->GetTimerManager().SetTimer(TickTimer, this, &UShoniSignificanceManager::CalculateSignificance, INTERVAL, true, 0.f);
+	DrainTimer = World->GetTimerManager().SetTimerForNextTick(this, &UShoniSignificanceManager::DrainRegistrations);
+	// anything registered before we existed can now be routed here
+	bRequiresUpdate.store(true, std::memory_order_release);
+	UE_LOG(LogShoniSignificance, Verbose, TEXT("Significance manager successfully initialised for %s"), *World->GetName());
+}
+
+void UShoniSignificanceManager::AddView(AActor* ViewActor)
+{
+	if (!ViewActor || ViewActor->GetWorld() != OwningWorld.Get()) return;
+	if (ViewStates.ContainsByPredicate([ViewActor](const FViewState& State) { return State.Actor == ViewActor; })) return;
+	ViewStates.AddDefaulted_GetRef().Actor = ViewActor;
+}
+
+void UShoniSignificanceManager::RemoveView(AActor* ViewActor)
+{
+	ViewStates.RemoveAll([ViewActor](const FViewState& State) { return State.Actor == ViewActor; });
+}
+
+void UShoniSignificanceManager::SetCameraPrediction(float InPredictionTime, float InPrefetchScale)
+{
+	PredictionTime = FMath::Max(InPredictionTime, 0.f);
+	PrefetchScale = FMath::Max(InPrefetchScale, 0.f);
+}
+
+void UShoniSignificanceManager::UpdateViewContext(FViewState& ViewState, double Now, FSignificanceViewContext& OutView) const
+{
+	const AActor* ViewActor = ViewState.Actor.Get();
+	const FVector Location = ViewActor->GetActorLocation();
+	if (ViewState.LastSampleTime >= 0.0 && Now > ViewState.LastSampleTime)
+	{
+		const FVector Instant = (Location - ViewState.LastLocation) / (Now - ViewState.LastSampleTime);
+		// smooth out jitter, but drop history entirely on a cut
+		ViewState.Velocity = Instant.SizeSquared() > FMath::Square(MAX_PREDICTED_SPEED) ? FVector::ZeroVector : FMath::Lerp(ViewState.Velocity, Instant, .5f);
+	}
+	ViewState.LastLocation = Location;
+	ViewState.LastSampleTime = Now;
+
+	// score against where the camera will be once this pass is applied
+	const FVector Travel = ViewState.Velocity * PredictionTime;
+	OutView.Location = Location + Travel;
+	OutView.Direction = ViewActor->GetActorForwardVector();
+	OutView.MaxDistance = CAM_DIST_MAX;
+	if (PrefetchScale > 0.f && !Travel.IsNearlyZero())
+	{
+		OutView.PrefetchDirection = Travel.GetUnsafeNormal();
+		OutView.PrefetchMargin = FMath::Min(Travel.Size() * PrefetchScale, CAM_DIST_MAX * .5f);
+	}
+	if (const UCameraComponent* CameraComp = ViewActor->FindComponentByClass<UCameraComponent>())
+	{
+		OutView.TanHalfFOV = FMath::Tan(FMath::DegreesToRadians(CameraComp->FieldOfView * 0.5f));
+	}
+}
+
+UShoniSignificanceManager* UShoniSignificanceManager::Get(const UWorld* World)
+{
+	const TWeakObjectPtr<UShoniSignificanceManager>* Found = World ? WorldManagers.Find(World) : nullptr;
+	return Found ? Found->Get() : nullptr;
+}
+
+void UShoniSignificanceManager::BeginDestroy()
+{
+	if (bIsInited)
 	{
-		bAsyncOperationInProgress = false;
-		CameraActor = Camera;
-		bIsInited = true;
-		Camera->GetWorld()->GetTimerManager().SetTimer(TickTimer, this, &UShoniSignificanceManager::CalculateSignificance, INTERVAL, true, 0.f);
-		UE_LOG(LogShoniSignificance, Verbose, TEXT("Significance manager successfully initialised"));
+		if (const TWeakObjectPtr<UShoniSignificanceManager>* Found = WorldManagers.Find(OwningWorld.Get()))
+		{
+			if (Found->Get() == this || !Found->IsValid()) WorldManagers.Remove(OwningWorld.Get());
+		}
+		if (OwningWorld.IsValid())
+		{
+			OwningWorld->GetTimerManager().ClearTimer(TickTimer);
+			OwningWorld->GetTimerManager().ClearTimer(DrainTimer);
+		}
+		// release every handle we own so they read zero from here on. A pass still in flight only touches the threadsafe
+		// copies on the worker, its game thread half sees bIsInited cleared and drops its results
+		for (const FSignificanceObject& SigObj : RegisteredObjects)
+		{
+			FreeSlot(*GetSlot(SigObj.SlotIndex));
+		}
+		for (const FSignificancePendingAdd& PendingAdd : ElementsToAdd)
+		{
+			if (IsHandleLive(PendingAdd.Handle)) FreeSlot(*GetSlot(PendingAdd.Handle.Index));
+		}
+		RegisteredObjects.Empty();
+		ElementsToAdd.Empty();
+		ElementsToRemove.Empty();
+		bIsInited = false;
 	}
+	Super::BeginDestroy();
+}
+
+bool UShoniSignificanceManager::IsReadyForFinishDestroy()
+{
+	// the background pass holds a pointer to us
+	return !bAsyncOperationInProgress && Super::IsReadyForFinishDestroy();
 }
 
-void UShoniSignificanceManager::RegisterObject(UObject* NewObject, ESignificanceTag SignificanceTag)
+FSignificanceSlot* UShoniSignificanceManager::ClaimSlot()
 {
-	if (!NewObject || !(NewObject->IsA(AActor::StaticClass()) || (NewObject->IsA(USceneComponent::StaticClass())))) return;
+	if (FSignificanceSlot* Recycled = FreeSlots.Pop())
+	{
+		return Recycled;
+	}
 
-	ElementsToAdd.Add(TPair<TWeakObjectPtr<UObject>, ESignificanceTag>(MakeWeakObjectPtr<UObject>(NewObject), SignificanceTag));
-	bRequiresUpdate = true;
+	const int32 SlotIndex = NumSlotsClaimed.fetch_add(1, std::memory_order_relaxed);
+	if (!ensureMsgf(SlotIndex < SLOTS_PER_PAGE * MAX_SLOT_PAGES, TEXT("Significance manager out of slots")))
+	{
+		return nullptr;
+	}
 
-	if (!bDebouncePending)
+	std::atomic<FSignificanceSlot*>& PagePtr = SlotPages[SlotIndex / SLOTS_PER_PAGE];
+	FSignificanceSlot* Page = PagePtr.load(std::memory_order_acquire);
+	if (!Page)
 	{
-		if (NewObject->GetWorld()) NewObject->GetWorld()->GetTimerManager().SetTimerForNextTick(&UShoniSignificanceManager::UpdateContainers);
-		bDebouncePending = true;
+		// first claimant of a page allocates it; anyone racing us throws theirs away and uses the winner's
+		FSignificanceSlot* NewPage = new FSignificanceSlot[SLOTS_PER_PAGE];
+		const int32 PageStart = SlotIndex - SlotIndex % SLOTS_PER_PAGE;
+		for (int32 i = 0; i < SLOTS_PER_PAGE; ++i)
+		{
+			NewPage[i].SlotIndex = PageStart + i;
+		}
+		if (PagePtr.compare_exchange_strong(Page, NewPage, std::memory_order_acq_rel))
+		{
+			Page = NewPage;
+		}
+		else
+		{
+			delete[] NewPage;
+		}
 	}
+	return Page + SlotIndex % SLOTS_PER_PAGE;
+}
+
+FSignificanceHandle UShoniSignificanceManager::RegisterObject(UObject* NewObject, ESignificanceTag SignificanceTag, float Importance)
+{
+	if (!NewObject || !(NewObject->IsA(AActor::StaticClass()) || (NewObject->IsA(USceneComponent::StaticClass())))) return FSignificanceHandle();
+
+	// slot is claimed now so the handle is usable straight away; it reads zero until the add is drained
+	FSignificanceSlot* Slot = ClaimSlot();
+	if (!Slot) return FSignificanceHandle();
+
+	const FSignificanceHandle Handle{ Slot->SlotIndex, Slot->Generation.load(std::memory_order_acquire) };
+	AddQueue.Enqueue({ Handle, MakeWeakObjectPtr<UObject>(NewObject), SignificanceTag, Importance });
+	NumQueuedAdds.fetch_add(1, std::memory_order_relaxed);
+	TotalRegistrations.fetch_add(1, std::memory_order_relaxed);
+	bRequiresUpdate.store(true, std::memory_order_release);
+	return Handle;
 }
 
 void UShoniSignificanceManager::DeregisterObject(UObject* OldObject)
 {
-	if (!OldObject || !OldObject->GetWorld()) return;
+	check(IsInGameThread());
+	if (!OldObject) return;
 
-	ElementsToRemove.AddUnique(OldObject);
-	bRequiresUpdate = true;
+	FSignificanceHandle Handle;
+	if (ObjectLookupTable.RemoveAndCopyValue(OldObject, Handle))
+	{
+		DeregisterObject(Handle);
+	}
+	else
+	{
+		// registered but not drained or not routed yet, so the table doesn't know it. Resolved, and counted if it was
+		// registered at all, after the next drain
+		ObjectsToRemove.Add(OldObject);
+		bRequiresUpdate.store(true, std::memory_order_release);
+	}
+}
+
+void UShoniSignificanceManager::DeregisterObject(FSignificanceHandle Handle)
+{
+	if (!IsHandleLive(Handle)) return;
+
+	RemoveQueue.Enqueue(Handle);
+	NumQueuedRemoves.fetch_add(1, std::memory_order_relaxed);
+	TotalDeregistrations.fetch_add(1, std::memory_order_relaxed);
+	bRequiresUpdate.store(true, std::memory_order_release);
+}
+
+void UShoniSignificanceManager::FreeSlot(FSignificanceSlot& Slot)
+{
+	// only drop the lookup if it still points at this registration
+	if (const FSignificanceHandle* Mapped = ObjectLookupTable.Find(Slot.Key))
+	{
+		if (Mapped->Index == Slot.SlotIndex && Mapped->Generation == Slot.Generation.load(std::memory_order_relaxed)) ObjectLookupTable.Remove(Slot.Key);
+	}
+	Slot.DenseIndex = INDEX_NONE;
+	Slot.Significance = 0.f;
+	Slot.Key = TObjectKey<UObject>();
+	Slot.Owner = nullptr;
+	// bumping the generation invalidates every outstanding handle to this slot
+	Slot.Generation.fetch_add(1, std::memory_order_release);
+	FreeSlots.Push(&Slot);
+}
+
+bool UShoniSignificanceManager::RouteAdd(const FSignificancePendingAdd& PendingAdd)
+{
+	FSignificanceSlot& Slot = *GetSlot(PendingAdd.Handle.Index);
+	UObject* Object = PendingAdd.Object.Get();
+	UShoniSignificanceManager* Manager = Get(Object->GetWorld());
+	if (!Manager) return false;
+
+	// registering the same object twice keeps the newest handle
+	FSignificanceHandle& Mapped = ObjectLookupTable.FindOrAdd(Object);
+	if (Mapped != PendingAdd.Handle && IsHandleLive(Mapped))
+	{
+		RouteRemoval(Mapped);
+	}
+	Mapped = PendingAdd.Handle;
+	Slot.Key = Object;
+	Slot.Owner = Manager;
+	Manager->ElementsToAdd.Add(PendingAdd);
+	return true;
+}
 
-	if (!bDebouncePending)
+void UShoniSignificanceManager::RouteRemoval(FSignificanceHandle Handle)
+{
+	if (!IsHandleLive(Handle)) return;
+
+	FSignificanceSlot& Slot = *GetSlot(Handle.Index);
+	if (Slot.Owner)
+	{
+		Slot.Owner->ElementsToRemove.Add(Handle);
+	}
+	else
+	{
+		// never routed, so nobody holds it. Freeing the slot makes the queued add skip itself
+		FreeSlot(Slot);
+	}
+}
+
+void UShoniSignificanceManager::RemoveRegistered(FSignificanceHandle Handle)
+{
+	if (!IsHandleLive(Handle)) return;
+
+	FSignificanceSlot& Slot = *GetSlot(Handle.Index);
+	const int32 Idx = Slot.DenseIndex;
+	if (RegisteredObjects.IsValidIndex(Idx))
 	{
-		if (OldObject->GetWorld()) OldObject->GetWorld()->GetTimerManager().SetTimerForNextTick(&UShoniSignificanceManager::UpdateContainers);
-		bDebouncePending = true;
+		UnbinObject(RegisteredObjects[Idx]);
+		RegisteredObjects.RemoveAtSwap(Idx, 1, false);
+		// the last element now lives at Idx, point its slot there
+		if (RegisteredObjects.IsValidIndex(Idx))
+		{
+			GetSlot(RegisteredObjects[Idx].SlotIndex)->DenseIndex = Idx;
+		}
 	}
+	FreeSlot(Slot);
 }
 
 void UShoniSignificanceManager::UpdateContainers()
 {
-	if (ElementsToAdd.Num() || ElementsToRemove.Num())
+	check(IsInGameThread());
+	SCOPE_CYCLE_COUNTER(STAT_ShoniSig_Drain);
+	if (bRequiresUpdate.exchange(false, std::memory_order_acq_rel))
 	{
-		// take care of memory allocation first
-		RegisteredObjects.Reserve(RegisteredObjects.Num() + ElementsToAdd.Num() - ElementsToRemove.Num());
-		// remove first to ensure index order integrity
-		for (auto& Obj : ElementsToRemove)
+		// drain everything queued so far in one go, retrying anything that arrived before its world's manager
+		DrainedAdds.Append(UnroutedAdds);
+		UnroutedAdds.Reset();
+		FSignificancePendingAdd PendingAdd;
+		while (AddQueue.Dequeue(PendingAdd))
+		{
+			DrainedAdds.Add(MoveTemp(PendingAdd));
+			NumQueuedAdds.fetch_sub(1, std::memory_order_relaxed);
+		}
+		// removals land in a set so repeats cost nothing
+		FSignificanceHandle PendingRemove;
+		while (RemoveQueue.Dequeue(PendingRemove))
 		{
-			if (Obj.IsValid() && ObjectLookupTable.Contains(Obj.Get()))
+			DrainedRemoves.Add(PendingRemove);
+			NumQueuedRemoves.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		for (const FSignificancePendingAdd& Obj : DrainedAdds)
+		{
+			if (!IsHandleLive(Obj.Handle)) continue;
+
+			if (!Obj.Object.IsValid())
 			{
-				const int32 Idx = ObjectLookupTable[Obj.Get()];
-				if (RegisteredObjects.IsValidIndex(Idx) && RegisteredObjects[Idx].Source.IsValid())
-				{
-					ObjectLookupTable.Remove(RegisteredObjects[Idx].Source.Get());
-					RegisteredObjects.RemoveAtSwap(Idx, 1, false);
-				}
+				// destroyed before it was ever added
+				FreeSlot(*GetSlot(Obj.Handle.Index));
+			}
+			else if (!RouteAdd(Obj))
+			{
+				UnroutedAdds.Add(Obj);
 			}
 		}
-		for (auto Obj : ElementsToAdd)
+		for (const FSignificanceHandle& Handle : DrainedRemoves)
 		{
-			if (Obj.Key.IsValid())
+			RouteRemoval(Handle);
+		}
+		for (const TObjectKey<UObject>& Key : ObjectsToRemove)
+		{
+			FSignificanceHandle Handle;
+			if (ObjectLookupTable.RemoveAndCopyValue(Key, Handle))
+			{
+				if (IsHandleLive(Handle)) TotalDeregistrations.fetch_add(1, std::memory_order_relaxed);
+				RouteRemoval(Handle);
+				continue;
+			}
+			// still waiting on its world's manager, so it never gets added at all
+			bool bFound = false;
+			for (int32 i = UnroutedAdds.Num() - 1; i >= 0; --i)
 			{
-				auto NewSigObj = FSignificanceObject(Obj.Key.Get(), Obj.Value);
-				int32 NewIdx = RegisteredObjects.Add(NewSigObj);
-				ObjectLookupTable.Add(Obj.Key.Get(), NewIdx);
+				if (TObjectKey<UObject>(UnroutedAdds[i].Object.Get()) != Key) continue;
+				if (IsHandleLive(UnroutedAdds[i].Handle)) FreeSlot(*GetSlot(UnroutedAdds[i].Handle.Index));
+				UnroutedAdds.RemoveAtSwap(i, 1, false);
+				bFound = true;
 			}
+			// never registered, nothing was deregistered
+			if (bFound) TotalDeregistrations.fetch_add(1, std::memory_order_relaxed);
+		}
+		UE_LOG(LogShoniSignificance, Verbose, TEXT("Registrations drained: %i added, %i removed, %i awaiting a manager"), DrainedAdds.Num(), DrainedRemoves.Num() + ObjectsToRemove.Num(), UnroutedAdds.Num());
+
+		DrainedAdds.Reset();
+		DrainedRemoves.Reset();
+		ObjectsToRemove.Reset();
+		// keep retrying unrouted adds on later passes
+		if (UnroutedAdds.Num()) bRequiresUpdate.store(true, std::memory_order_release);
+	}
+
+	for (auto It = WorldManagers.CreateIterator(); It; ++It)
+	{
+		if (UShoniSignificanceManager* Manager = It.Value().Get())
+		{
+			Manager->ApplyContainerChanges();
+		}
+		else
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void UShoniSignificanceManager::ApplyContainerChanges()
+{
+	// indices are held by the in-flight pass; it calls back in here once applied
+	if (bAsyncOperationInProgress || (!ElementsToAdd.Num() && !ElementsToRemove.Num())) return;
+
+	// take care of memory allocation first
+	RegisteredObjects.Reserve(RegisteredObjects.Num() + ElementsToAdd.Num());
+	// remove first so adds cancelled before they landed are skipped below
+	for (const FSignificanceHandle& Handle : ElementsToRemove)
+	{
+		RemoveRegistered(Handle);
+	}
+	for (const FSignificancePendingAdd& Obj : ElementsToAdd)
+	{
+		if (!IsHandleLive(Obj.Handle)) continue;
+
+		FSignificanceSlot& Slot = *GetSlot(Obj.Handle.Index);
+		if (!Obj.Object.IsValid())
+		{
+			FreeSlot(Slot);
+			continue;
+		}
+		auto NewSigObj = FSignificanceObject(Obj.Object.Get(), Obj.SignificanceTag, Obj.Importance);
+		NewSigObj.Interface = Cast<ISignificanceInterface>(Obj.Object.Get());
+		// villagers drive their AI LOD from the raw value, everything else only cares about on/off
+		NewSigObj.bWantsValueUpdates = NewSigObj.Interface && Obj.Object->IsA(AVillager::StaticClass());
+		NewSigObj.SlotIndex = Obj.Handle.Index;
+		Slot.DenseIndex = RegisteredObjects.Add(NewSigObj);
+		if (bSpatialCulling)
+		{
+			FSignificanceObject& Added = RegisteredObjects[Slot.DenseIndex];
+			BinObject(Added, Added.GetTransform().GetLocation());
 		}
 	}
 	UE_LOG(LogShoniSignificance, Verbose, TEXT("Elements added: %i"), ElementsToAdd.Num());
 	UE_LOG(LogShoniSignificance, Verbose, TEXT("Elements removed: %i"), ElementsToRemove.Num());
 	UE_LOG(LogShoniSignificance, Verbose, TEXT("Total elements managed: %i"), RegisteredObjects.Num());
 
-	ElementsToAdd.Empty();
-	ElementsToRemove.Empty();
-	bRequiresUpdate = false;
-	bDebouncePending = false;
+	ElementsToAdd.Reset();
+	ElementsToRemove.Reset();
 }
 
-void UShoniSignificanceManager::CalculateSignificance()
+void UShoniSignificanceManager::SetTagBudget(ESignificanceTag SignificanceTag, int32 MaxActive)
+{
+	if (SignificanceTag >= SIG_MAX) return;
+	TagConfigs[SignificanceTag].Budget = MaxActive < 0 ? INDEX_NONE : MaxActive;
+	UE_LOG(LogShoniSignificance, Verbose, TEXT("Budget for tag %i set to %i"), (int32)SignificanceTag, TagConfigs[SignificanceTag].Budget);
+}
+
+void UShoniSignificanceManager::SetTagConfig(ESignificanceTag SignificanceTag, const FSignificanceTagConfig& Config)
 {
-	if (!bIsInited || bAsyncOperationInProgress || !CameraActor.IsValid()) return;
-	// populate cache
-	AsyncTransformQueue.Empty();
-	for (const auto& SigOb : RegisteredObjects)
+	if (SignificanceTag >= SIG_MAX) return;
+	TagConfigs[SignificanceTag] = Config;
+}
+
+void UShoniSignificanceManager::SetTagScorer(ESignificanceTag SignificanceTag, FSignificanceBucketScorer Scorer, uint32 FactorMask)
+{
+	if (SignificanceTag >= SIG_MAX) return;
+	// null restores the compiled-in default
+	TagScorers[SignificanceTag] = Scorer ? Scorer : ShoniSignificance::GetDefaultScorer(SignificanceTag);
+	TagFactors[SignificanceTag] = Scorer ? FactorMask : ShoniSignificance::GetDefaultFactors(SignificanceTag);
+}
+
+void UShoniSignificanceManager::ScoreTagRanges()
+{
+	for (int32 Tag = 0; Tag < SIG_MAX; ++Tag)
 	{
-		AsyncTransformQueue.Add(TPair<FTransform, float>(SigOb.GetTransform(), 0.f));
+		if (TagRangeNum[Tag] && TagScorers_Threadsafe[Tag])
+		{
+			TagScorers_Threadsafe[Tag](TArrayView<FSignificanceAsyncEntry>(AsyncTransformQueue.GetData() + TagRangeStart[Tag], TagRangeNum[Tag]), Views_Threadsafe, TagConfigs_Threadsafe[Tag]);
+		}
 	}
-	CameraLocation_Threadsafe = CameraActor.Get()->GetActorLocation();
-	CameraDirection_Threadsafe = CameraActor.Get()->GetActorForwardVector();
-	if (!AsyncTransformQueue.IsEmpty())
+}
+
+void UShoniSignificanceManager::SetSpatialCulling(bool bEnabled, float InCellSize)
+{
+	check(IsInGameThread());
+	// rebuilt from scratch, also picks up a new cell size
+	SpatialCells.Reset();
+	ActiveSlots.Reset();
+	for (FSignificanceObject& SigObj : RegisteredObjects)
 	{
-		bAsyncOperationInProgress = true;
-		AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [this]()
+		SigObj.bIsBinned = false;
+	}
+	bSpatialCulling = bEnabled;
+	SpatialCellSize = FMath::Max(InCellSize, 100.f);
+	if (!bSpatialCulling) return;
+
+	for (FSignificanceObject& SigObj : RegisteredObjects)
+	{
+		BinObject(SigObj, SigObj.GetTransform().GetLocation());
+		if (SigObj.CachedSignificance > 0.f) ActiveSlots.Add(SigObj.SlotIndex);
+	}
+	UE_LOG(LogShoniSignificance, Log, TEXT("Spatial culling enabled: %i objects in %i cells"), RegisteredObjects.Num(), SpatialCells.Num());
+}
+
+FIntPoint UShoniSignificanceManager::GetSpatialCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / SpatialCellSize), FMath::FloorToInt(Location.Y / SpatialCellSize));
+}
+
+void UShoniSignificanceManager::BinObject(FSignificanceObject& SigObj, const FVector& Location)
+{
+	const FIntPoint Cell = GetSpatialCell(Location);
+	if (SigObj.bIsBinned && SigObj.SpatialCell == Cell) return;
+
+	UnbinObject(SigObj);
+	SpatialCells.FindOrAdd(Cell).Add(SigObj.SlotIndex);
+	SigObj.SpatialCell = Cell;
+	SigObj.bIsBinned = true;
+}
+
+void UShoniSignificanceManager::UnbinObject(FSignificanceObject& SigObj)
+{
+	if (!SigObj.bIsBinned) return;
+	// empty cells are kept, objects tend to wander back into them
+	if (TArray<int32>* CellSlots = SpatialCells.Find(SigObj.SpatialCell))
+	{
+		CellSlots->RemoveSingleSwap(SigObj.SlotIndex, false);
+	}
+	SigObj.bIsBinned = false;
+}
+
+void UShoniSignificanceManager::GatherSpatialCandidates()
+{
+	++GatherPass;
+	CandidateIndices.Reset();
+	auto AddCandidate = [this](int32 DenseIndex)
+		{
+			FSignificanceObject& SigObj = RegisteredObjects[DenseIndex];
+			if (SigObj.GatherStamp == GatherPass) return;
+			SigObj.GatherStamp = GatherPass;
+			CandidateIndices.Add(DenseIndex);
+		};
+
+	// last pass's significant set, so anything that left range still gets its deactivation
+	for (int32 SlotIdx : ActiveSlots)
+	{
+		const FSignificanceSlot* Slot = GetSlot(SlotIdx);
+		if (Slot->Owner == this && RegisteredObjects.IsValidIndex(Slot->DenseIndex) && RegisteredObjects[Slot->DenseIndex].SlotIndex == SlotIdx)
+		{
+			AddCandidate(Slot->DenseIndex);
+		}
+	}
+
+	float MaxRangeScale = 0.f;
+	for (int32 Tag = 0; Tag < SIG_MAX; ++Tag)
+	{
+		MaxRangeScale = FMath::Max(MaxRangeScale, TagConfigs[Tag].RangeScale);
+	}
+	for (const FSignificanceViewContext& View : Views_Threadsafe)
+	{
+		// a cell of slack covers objects that moved since they were last binned
+		const float Radius = (View.MaxDistance + View.PrefetchMargin) * MaxRangeScale + SpatialCellSize;
+		const FIntPoint Min = GetSpatialCell(View.Location - FVector(Radius));
+		const FIntPoint Max = GetSpatialCell(View.Location + FVector(Radius));
+		for (int32 X = Min.X; X <= Max.X; ++X)
+		{
+			for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
 			{
-				int32 NumSignificant = 0;
-				for (auto& SigObj : AsyncTransformQueue)
+				if (const TArray<int32>* CellSlots = SpatialCells.Find(FIntPoint(X, Y)))
 				{
-					const FVector ObjLocation = SigObj.Key.GetLocation();
-					const float Dist = FVector::Dist(ObjLocation, CameraLocation_Threadsafe);
+					for (int32 SlotIdx : *CellSlots)
+					{
+						AddCandidate(GetSlot(SlotIdx)->DenseIndex);
+					}
+				}
+			}
+		}
+	}
+
+	// candidates are re-binned as they are gathered, walk a window of the rest
+	const int32 NumToRebin = FMath::Min(REBIN_PER_PASS, RegisteredObjects.Num());
+	for (int32 n = 0; n < NumToRebin; ++n)
+	{
+		RebinCursor = (RebinCursor + 1) % RegisteredObjects.Num();
+		FSignificanceObject& SigObj = RegisteredObjects[RebinCursor];
+		if (SigObj.GatherStamp != GatherPass) BinObject(SigObj, SigObj.GetTransform().GetLocation());
+	}
+}
+
+int32 UShoniSignificanceManager::ApplyTagBudgets()
+{
+	int32 NumCulled = 0;
+	for (int32 Tag = 0; Tag < SIG_MAX; ++Tag)
+	{
+		const int32 Budget = TagConfigs_Threadsafe[Tag].Budget;
+		if (Budget == INDEX_NONE || TagRangeNum[Tag] <= Budget) continue;
+
+		TArray<int32>& Bucket = TagCandidates[Tag];
+		Bucket.Reset();
+		for (int32 i = TagRangeStart[Tag]; i < TagRangeStart[Tag] + TagRangeNum[Tag]; ++i)
+		{
+			if (AsyncTransformQueue[i].Value > 0.f) Bucket.Add(i);
+		}
+		if (Bucket.Num() <= Budget) continue;
+
+		// partial selection: everything before Budget ends up more significant than everything after it,
+		// no ordering is paid for within either side
+		int32* First = Bucket.GetData();
+		std::nth_element(First, First + Budget, First + Bucket.Num(), [this](int32 A, int32 B)
+			{
+				return AsyncTransformQueue[A].Value > AsyncTransformQueue[B].Value;
+			});
+		for (int32 k = Budget; k < Bucket.Num(); ++k)
+		{
+			AsyncTransformQueue[Bucket[k]].Value = 0.f;
+		}
+		NumCulled += Bucket.Num() - Budget;
+	}
+	return NumCulled;
+}
+
+void UShoniSignificanceManager::BuildChangeLists()
+{
+	for (int32 Tag = 0; Tag < SIG_MAX; ++Tag)
+	{
+		FSignificanceChangeList& Changes = TagChanges[Tag];
+		Changes.Reset();
+		// owners of score-only tags poll GetSignificance themselves
+		if (!TagConfigs_Threadsafe[Tag].bNotifyTransitions) continue;
+
+		for (int32 i = TagRangeStart[Tag]; i < TagRangeStart[Tag] + TagRangeNum[Tag]; ++i)
+		{
+			const FSignificanceAsyncEntry& Entry = AsyncTransformQueue[i];
+			const bool bWasSignificant = Entry.PrevValue > 0.f;
+			const bool bIsSignificant = Entry.Value > 0.f;
+			// call all objects on first pass to ensure correct state initialised
+			if (bIsSignificant && (!bWasSignificant || bFirstPass_Threadsafe))
+			{
+				Changes.Activated.Add(i);
+			}
+			else if (!bIsSignificant && (bWasSignificant || bFirstPass_Threadsafe))
+			{
+				Changes.Deactivated.Add(i);
+			}
+			else if (bIsSignificant && Entry.bWantsValueUpdates)
+			{
+				Changes.ValueChanged.Add(i);
+			}
+		}
+	}
+}
+
+void UShoniSignificanceManager::ApplyChangeLists()
+{
+	for (int32 Tag = 0; Tag < SIG_MAX; ++Tag)
+	{
+		const FSignificanceChangeList& Changes = TagChanges[Tag];
+		for (int32 i : Changes.Activated)
+		{
+			const FSignificanceObject& SigObj = RegisteredObjects[AsyncTransformQueue[i].ObjectIndex];
+			if (SigObj.Interface && SigObj.Source.IsValid()) SigObj.Interface->OnSignificanceChanged(true);
+		}
+		for (int32 i : Changes.Deactivated)
+		{
+			const FSignificanceObject& SigObj = RegisteredObjects[AsyncTransformQueue[i].ObjectIndex];
+			if (SigObj.Interface && SigObj.Source.IsValid()) SigObj.Interface->OnSignificanceChanged(false);
+		}
+		for (int32 i : Changes.ValueChanged)
+		{
+			const FSignificanceAsyncEntry& Entry = AsyncTransformQueue[i];
+			const FSignificanceObject& SigObj = RegisteredObjects[Entry.ObjectIndex];
+			if (SigObj.Source.IsValid()) SigObj.Interface->OnSignificanceValueChanged(Entry.PrevValue, Entry.Value);
+		}
+	}
+	ActiveSlots.Reset();
+	for (const FSignificanceAsyncEntry& Entry : AsyncTransformQueue)
+	{
+		FSignificanceObject& SigObj = RegisteredObjects[Entry.ObjectIndex];
+		SigObj.SetCachedSignificance(Entry.Value);
+		GetSlot(SigObj.SlotIndex)->Significance = Entry.Value;
+		if (bSpatialCulling && Entry.Value > 0.f) ActiveSlots.Add(SigObj.SlotIndex);
+	}
+}
+
+void UShoniSignificanceManager::RecordTraceSample(int32 NumSignificant)
+{
+	FTraceSample& Sample = PendingTraceSample;
+	Sample.Time = FPlatformTime::Seconds();
+	Sample.NumRegistered = RegisteredObjects.Num();
+	Sample.NumScored = AsyncTransformQueue.Num();
+	Sample.NumSignificant = NumSignificant;
+	Sample.NumUnrouted = UnroutedAdds.Num();
+	for (int32 Tag = 0; Tag < SIG_MAX; ++Tag)
+	{
+		Sample.Transitions[Tag] = TagChanges[Tag].NumTransitions();
+	}
+	// registration counters are process wide, so rates are too
+	const uint32 Registrations = TotalRegistrations.load(std::memory_order_relaxed);
+	const uint32 Deregistrations = TotalDeregistrations.load(std::memory_order_relaxed);
+	if (LastTraceTime > 0.0 && Sample.Time > LastTraceTime)
+	{
+		const double Elapsed = Sample.Time - LastTraceTime;
+		Sample.RegistrationsPerSec = (Registrations - LastTotalRegistrations) / Elapsed;
+		Sample.DeregistrationsPerSec = (Deregistrations - LastTotalDeregistrations) / Elapsed;
+	}
+	LastTraceTime = Sample.Time;
+	LastTotalRegistrations = Registrations;
+	LastTotalDeregistrations = Deregistrations;
 
-					const FVector DirToObj = (ObjLocation - CameraLocation_Threadsafe).GetSafeNormal();
+	SET_FLOAT_STAT(STAT_ShoniSig_ScoreMs, Sample.ScoreMs);
+	SET_DWORD_STAT(STAT_ShoniSig_Registered, Sample.NumRegistered);
+	SET_DWORD_STAT(STAT_ShoniSig_Scored, Sample.NumScored);
+	SET_DWORD_STAT(STAT_ShoniSig_Significant, Sample.NumSignificant);
+	SET_DWORD_STAT(STAT_ShoniSig_TransitionsGameplay, Sample.Transitions[SIG_Gameplay]);
+	SET_DWORD_STAT(STAT_ShoniSig_TransitionsRendering, Sample.Transitions[SIG_Rendering]);
+	SET_DWORD_STAT(STAT_ShoniSig_TransitionsAudio, Sample.Transitions[SIG_Audio]);
+	SET_DWORD_STAT(STAT_ShoniSig_TransitionsNiagara, Sample.Transitions[SIG_Niagara]);
+	SET_FLOAT_STAT(STAT_ShoniSig_RegistrationRate, Sample.RegistrationsPerSec);
+	SET_FLOAT_STAT(STAT_ShoniSig_DeregistrationRate, Sample.DeregistrationsPerSec);
+	SET_DWORD_STAT(STAT_ShoniSig_Unrouted, Sample.NumUnrouted);
 
-					const float FacingDot = FVector::DotProduct(CameraDirection_Threadsafe, DirToObj);
+	// fixed size ring, oldest sample overwritten
+	if (TraceBuffer.Num() < TRACE_CAPACITY)
+	{
+		TraceBuffer.Add(Sample);
+	}
+	else
+	{
+		TraceBuffer[TraceHead] = Sample;
+	}
+	TraceHead = (TraceHead + 1) % TRACE_CAPACITY;
+}
 
-					const float DistanceScale = FMath::Lerp(0.5f, 1.0f, (FacingDot + 1.f) * 0.5f);
-					const float ScaledMaxDist = CAM_DIST_MAX * DistanceScale;
+bool UShoniSignificanceManager::DumpTraceToCSV(const FString& FilePath) const
+{
+	if (TraceBuffer.IsEmpty()) return false;
 
-					// Linear falloff significance
-					SigObj.Value = (Dist <= ScaledMaxDist && ScaledMaxDist > 0.f) ? 1.f - (Dist / ScaledMaxDist) : 0.f;
+	FString Csv = TEXT("Time,GatherMs,ScoreMs,ApplyMs,Registered,Scored,Significant,TransitionsGameplay,TransitionsRendering,TransitionsAudio,TransitionsNiagara,RegistrationsPerSec,DeregistrationsPerSec,AddQueueDepth,RemoveQueueDepth,AwaitingManager\n");
+	// oldest first: once the ring has wrapped the oldest sample sits at the head
+	const int32 Start = TraceBuffer.Num() < TRACE_CAPACITY ? 0 : TraceHead;
+	for (int32 i = 0; i < TraceBuffer.Num(); ++i)
+	{
+		const FTraceSample& Sample = TraceBuffer[(Start + i) % TraceBuffer.Num()];
+		Csv += FString::Printf(TEXT("%.3f,%.3f,%.3f,%.3f,%i,%i,%i,%i,%i,%i,%i,%.1f,%.1f,%i,%i,%i\n"),
+			Sample.Time, Sample.GatherMs, Sample.ScoreMs, Sample.ApplyMs, Sample.NumRegistered, Sample.NumScored, Sample.NumSignificant,
+			Sample.Transitions[SIG_Gameplay], Sample.Transitions[SIG_Rendering], Sample.Transitions[SIG_Audio], Sample.Transitions[SIG_Niagara],
+			Sample.RegistrationsPerSec, Sample.DeregistrationsPerSec, Sample.AddQueueDepth, Sample.RemoveQueueDepth, Sample.NumUnrouted);
+	}
+	return FFileHelper::SaveStringToFile(Csv, *FilePath);
+}
 
+void UShoniSignificanceManager::SampleQueueDepths()
+{
+	const int32 AddQueueDepth = NumQueuedAdds.load(std::memory_order_relaxed);
+	const int32 RemoveQueueDepth = NumQueuedRemoves.load(std::memory_order_relaxed);
+	SET_DWORD_STAT(STAT_ShoniSig_AddQueueDepth, AddQueueDepth);
+	SET_DWORD_STAT(STAT_ShoniSig_RemoveQueueDepth, RemoveQueueDepth);
+	PeakAddQueueDepth = FMath::Max(PeakAddQueueDepth, AddQueueDepth);
+	PeakRemoveQueueDepth = FMath::Max(PeakRemoveQueueDepth, RemoveQueueDepth);
+}
+
+void UShoniSignificanceManager::DrainRegistrations()
+{
+	if (!bIsInited || !OwningWorld.IsValid()) return;
+	SampleQueueDepths();
+	// adds held back by a pass in flight are applied once it lands, same as before
+	UpdateContainers();
+	DrainTimer = OwningWorld->GetTimerManager().SetTimerForNextTick(this, &UShoniSignificanceManager::DrainRegistrations);
+}
+
+void UShoniSignificanceManager::CalculateSignificance()
+{
+	if (!bIsInited || bAsyncOperationInProgress || !OwningWorld.IsValid()) return;
+	// queue depths are sampled before the drain empties them
+	SampleQueueDepths();
+	PendingTraceSample = FTraceSample();
+	PendingTraceSample.AddQueueDepth = PeakAddQueueDepth;
+	PendingTraceSample.RemoveQueueDepth = PeakRemoveQueueDepth;
+	PeakAddQueueDepth = 0;
+	PeakRemoveQueueDepth = 0;
+	// pick up anything registered since the last drain
+	UpdateContainers();
+
+	SCOPE_CYCLE_COUNTER(STAT_ShoniSig_Gather);
+	const double GatherStart = FPlatformTime::Seconds();
+
+	// one context per live view, all scored in the same pass
+	Views_Threadsafe.Reset();
+	ViewStates.RemoveAll([](const FViewState& State) { return !State.Actor.IsValid(); });
+	const double Now = OwningWorld->GetTimeSeconds();
+	for (FViewState& ViewState : ViewStates)
+	{
+		UpdateViewContext(ViewState, Now, Views_Threadsafe.AddDefaulted_GetRef());
+	}
+	if (Views_Threadsafe.IsEmpty()) return;
+
+	// the first pass always covers everything so every object gets its initial state
+	const bool bCulled = bSpatialCulling && bFirstPassComplete;
+	if (bCulled) GatherSpatialCandidates();
+	const int32 NumToGather = bCulled ? CandidateIndices.Num() : RegisteredObjects.Num();
+
+	// populate cache, grouped by tag so each tag's scorer runs over a contiguous range
+	int32 TagCounts[SIG_MAX] = {};
+	for (int32 n = 0; n < NumToGather; ++n)
+	{
+		++TagCounts[RegisteredObjects[bCulled ? CandidateIndices[n] : n].SignificanceTag];
+	}
+	int32 Offset = 0;
+	for (int32 Tag = 0; Tag < SIG_MAX; ++Tag)
+	{
+		TagRangeStart[Tag] = Offset;
+		TagRangeNum[Tag] = 0;
+		Offset += TagCounts[Tag];
+	}
+	AsyncTransformQueue.SetNum(NumToGather, false);
+
+	const float WorldTime = OwningWorld->GetTimeSeconds();
+	for (int32 n = 0; n < NumToGather; ++n)
+	{
+		const int32 i = bCulled ? CandidateIndices[n] : n;
+		FSignificanceObject& SigOb = RegisteredObjects[i];
+		const ESignificanceTag Tag = SigOb.SignificanceTag;
+		FSignificanceAsyncEntry& Entry = AsyncTransformQueue[TagRangeStart[Tag] + TagRangeNum[Tag]++];
+		Entry.Location = SigOb.GetTransform().GetLocation();
+		if (bSpatialCulling) BinObject(SigOb, Entry.Location);
+		Entry.Importance = SigOb.Importance;
+		Entry.PrevValue = SigOb.CachedSignificance;
+		Entry.bWantsValueUpdates = SigOb.bWantsValueUpdates;
+		Entry.ObjectIndex = i;
+		Entry.SignificanceTag = Tag;
+		Entry.Value = 0.f;
+		// only pay for the inputs this tag's scorer actually reads
+		Entry.BoundsRadius = (TagFactors[Tag] & SF_ScreenSize) ? SigOb.GetBoundsRadius() : 0.f;
+		Entry.TimeSinceSeen = (TagFactors[Tag] & SF_Recency) ? SigOb.GetTimeSinceSeen(WorldTime) : -1.f;
+	}
+
+	for (int32 Tag = 0; Tag < SIG_MAX; ++Tag)
+	{
+		TagConfigs_Threadsafe[Tag] = TagConfigs[Tag];
+		TagScorers_Threadsafe[Tag] = TagScorers[Tag];
+	}
+	bFirstPass_Threadsafe = !bFirstPassComplete;
+	PendingTraceSample.GatherMs = (FPlatformTime::Seconds() - GatherStart) * 1000.0;
+	if (!AsyncTransformQueue.IsEmpty())
+	{
+		bAsyncOperationInProgress = true;
+		AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [this]()
+			{
+				SCOPE_CYCLE_COUNTER(STAT_ShoniSig_Score);
+				const double ScoreStart = FPlatformTime::Seconds();
+				ScoreTagRanges();
+				// anything over its tag's budget is culled back to zero
+				ApplyTagBudgets();
+
+				BuildChangeLists();
+
+				int32 NumSignificant = 0;
+				for (const auto& SigObj : AsyncTransformQueue)
+				{
 					if (SigObj.Value > 0.f) ++NumSignificant;
 				}
+				PendingTraceSample.ScoreMs = (FPlatformTime::Seconds() - ScoreStart) * 1000.0;
 				AsyncTask(ENamedThreads::GameThread, [this, NumSignificant]()
 					{
-						if (!IsValid(this)) return;
-						for (int32 i = 0; i < RegisteredObjects.Num(); ++i)
+						// BeginDestroy already emptied what the change lists index into, just let IsReadyForFinishDestroy through
+						if (!bIsInited || HasAnyFlags(RF_BeginDestroyed) || !IsValid(this))
+						{
+							bAsyncOperationInProgress = false;
+							return;
+						}
 						{
-							// call all objects on first pass to ensure correct state initialised
-							if (!bFirstPassComplete)
-							{
-								if (AsyncTransformQueue[i].Value > 0.f)
-								{
-									if (auto Int_Obj = Cast<ISignificanceInterface>(RegisteredObjects[i].Source))
-									{
-										Int_Obj->OnSignificanceChanged(true);
-									}
-								}
-								else
-								{
-									if (auto Int_Obj = Cast<ISignificanceInterface>(RegisteredObjects[i].Source))
-									{
-										Int_Obj->OnSignificanceChanged(false);
-									}
-								}
-							}
-							else
-							{
-								if (!RegisteredObjects[i].Source.IsValid()) continue;
-
-								// particles
-								if (RegisteredObjects[i].SignificanceTag == SIG_Niagara)
-								{
-									// spirit VFX handled by player controller
-								}
-								// game actors
-								else
-								{
-									if (RegisteredObjects[i].CachedSignificance <= 0.f && AsyncTransformQueue[i].Value > 0.f)
-									{
-										if (auto Int_Obj = Cast<ISignificanceInterface>(RegisteredObjects[i].Source))
-										{
-											Int_Obj->OnSignificanceChanged(true);
-										}
-									}
-									else if (RegisteredObjects[i].CachedSignificance > 0.f && AsyncTransformQueue[i].Value <= 0.f)
-									{
-										if (auto Int_Obj = Cast<ISignificanceInterface>(RegisteredObjects[i].Source))
-										{
-											Int_Obj->OnSignificanceChanged(false);
-										}
-									}
-									else if (AsyncTransformQueue[i].Value > 0.f && RegisteredObjects[i].Source->IsA(AVillager::StaticClass()))
-									{
-										if (auto Int_Obj = Cast<ISignificanceInterface>(RegisteredObjects[i].Source))
-										{
-											Int_Obj->OnSignificanceValueChanged(RegisteredObjects[i].CachedSignificance, AsyncTransformQueue[i].Value);
-										}
-									}
-								}
-							}
-							RegisteredObjects[i].SetCachedSignificance(AsyncTransformQueue[i].Value);
+							SCOPE_CYCLE_COUNTER(STAT_ShoniSig_Apply);
+							const double ApplyStart = FPlatformTime::Seconds();
+							ApplyChangeLists();
+							PendingTraceSample.ApplyMs = (FPlatformTime::Seconds() - ApplyStart) * 1000.0;
 						}
-						AsyncTransformQueue.Empty();
-						// if we have anny elements added and a timer hasn't already been set for an update, go ahead and update
-						if (bRequiresUpdate && !bDebouncePending) UpdateContainers();
 						bAsyncOperationInProgress = false;
+						// apply anything that queued up while the pass was in flight
+						UpdateContainers();
+						RecordTraceSample(NumSignificant);
 						UE_LOG(LogShoniSignificance, Verbose, TEXT("Significance updated. %i objects significant"), NumSignificant);
 						bFirstPassComplete = true;
 					});
@@ -3,16 +3,43 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Components/PrimitiveComponent.h"
+#include "Containers/Queue.h"
+#include "Containers/LockFreeList.h"
+#include "ShoniSignificanceScoring.h"
+#include <atomic>
 #include "ShoniSignificanceManager.generated.h"
 
 
 
-enum ESignificanceTag
+class ISignificanceInterface;
+class UShoniSignificanceManager;
+
+/* Returned by RegisterObject. Lookup is a bounds check plus a generation compare, stale handles read as zero */
+struct FSignificanceHandle
+{
+	int32 Index = INDEX_NONE;
+	uint32 Generation = 0;
+
+	bool IsSet() const { return Index != INDEX_NONE; }
+	bool operator==(const FSignificanceHandle& Other) const { return Index == Other.Index && Generation == Other.Generation; }
+	bool operator!=(const FSignificanceHandle& Other) const { return !(*this == Other); }
+	friend uint32 GetTypeHash(const FSignificanceHandle& Handle) { return HashCombine(::GetTypeHash(Handle.Index), ::GetTypeHash(Handle.Generation)); }
+};
+
+/* Indirection between a handle and the object's current position in the dense array.
+ * Slots live in pages that never move, so any thread can claim one without locking */
+struct FSignificanceSlot
 {
-	SIG_Gameplay,
-	SIG_Rendering,
-	SIG_Audio,
-	SIG_Niagara
+	int32 SlotIndex = INDEX_NONE;
+	std::atomic<uint32> Generation{ 0 };
+	// game thread only. INDEX_NONE while the add is pending or after removal
+	int32 DenseIndex = INDEX_NONE;
+	// game thread only. Mirrors the owner's cached value so handle lookups don't need the owning manager
+	float Significance = 0.f;
+	// game thread only, set when the add is routed to a world's manager
+	TObjectKey<UObject> Key;
+	UShoniSignificanceManager* Owner = nullptr;
 };
 
 struct FSignificanceObject
@@ -21,11 +48,23 @@ struct FSignificanceObject
 	TWeakObjectPtr<AActor> Actor;
 	TWeakObjectPtr<USceneComponent> Component;
 	const ESignificanceTag SignificanceTag;
+	// gameplay weight fed to scorers that use SF_Importance
+	float Importance = 1.f;
 
 	float CachedSignificance = 0.f;
 
-	explicit FSignificanceObject(UObject* InObject, ESignificanceTag INTag)
-		: Source(InObject), SignificanceTag(INTag)
+	// resolved once in UpdateContainers so the apply loop never casts. Only dereference while Source is valid
+	ISignificanceInterface* Interface = nullptr;
+	bool bWantsValueUpdates = false;
+	// owning slot, kept in sync on swap-removal
+	int32 SlotIndex = INDEX_NONE;
+	// spatial culling bookkeeping, only maintained while the manager has it enabled
+	FIntPoint SpatialCell = FIntPoint::ZeroValue;
+	bool bIsBinned = false;
+	uint32 GatherStamp = 0;
+
+	explicit FSignificanceObject(UObject* InObject, ESignificanceTag INTag, float InImportance = 1.f)
+		: Source(InObject), SignificanceTag(INTag), Importance(InImportance)
 	{
 		if (AActor* AsActor = Cast<AActor>(InObject))
 		{
@@ -52,56 +91,277 @@ struct FSignificanceObject
 		return FTransform::Identity;
 	}
 
+	/* Game thread only */
+	float GetBoundsRadius() const
+	{
+		if (Actor.IsValid())
+		{
+			return Actor->GetRootComponent() ? Actor->GetRootComponent()->Bounds.SphereRadius : 0.f;
+		}
+		else if (Component.IsValid())
+		{
+			return Component->Bounds.SphereRadius;
+		}
+		return 0.f;
+	}
+
+	/* Game thread only. Negative if the object has nothing that renders */
+	float GetTimeSinceSeen(float WorldTime) const
+	{
+		if (Actor.IsValid())
+		{
+			return WorldTime - Actor->GetLastRenderTime();
+		}
+		else if (const UPrimitiveComponent* AsPrim = Cast<UPrimitiveComponent>(Component.Get()))
+		{
+			return WorldTime - AsPrim->GetLastRenderTimeOnScreen();
+		}
+		return -1.f;
+	}
+
 	void SetCachedSignificance(float NewSignificance)
 	{
 		CachedSignificance = NewSignificance;
 	}
 };
 
+struct FSignificancePendingAdd
+{
+	FSignificanceHandle Handle;
+	TWeakObjectPtr<UObject> Object;
+	ESignificanceTag SignificanceTag;
+	float Importance;
+};
+
 UCLASS()
 class SHONIISLAND_API UShoniSignificanceManager : public UObject
 {
 	GENERATED_BODY()
 
 public:
+	UShoniSignificanceManager();
+	/* Binds the manager to the camera's world and starts updating. Calling again with another actor adds a view */
 	void Init(AActor* Camera);
-	static void RegisterObject(UObject* NewObject, ESignificanceTag SignificanceTag);
+	/* Extra viewpoints (split screen, spectators). An object's significance is its best score across all views */
+	void AddView(AActor* ViewActor);
+	void RemoveView(AActor* ViewActor);
+	int32 GetNumViews() const { return ViewStates.Num(); }
+	/* Views are scored from where they are predicted to be PredictionTime seconds ahead, covering the latency between
+	 * snapshot and apply. PrefetchScale widens the range in the direction of travel by that fraction of the
+	 * predicted travel distance so activation starts before objects come into view. Zero disables either */
+	void SetCameraPrediction(float InPredictionTime, float InPrefetchScale);
+	/* Game thread only. Null if no manager has been initialised for the world */
+	static UShoniSignificanceManager* Get(const UWorld* World);
+	virtual void BeginDestroy() override;
+	virtual bool IsReadyForFinishDestroy() override;
+
+	/* Safe from any thread. The handle is valid immediately and reads zero until the object is routed to its
+	 * world's manager and scored */
+	static FSignificanceHandle RegisterObject(UObject* NewObject, ESignificanceTag SignificanceTag, float Importance = 1.f);
+	/* Game thread only, needs the lookup table */
 	static void DeregisterObject(UObject* OldObject);
+	/* Safe from any thread */
+	static void DeregisterObject(FSignificanceHandle Handle);
+	/* Game thread only. Drains the registration queues in bulk, routes them per world and applies them to every idle manager */
 	static void UpdateContainers();
-	static float GetSignificance(UObject* Caller)
+	/* Caps the number of objects of a tag that can be significant at once. INDEX_NONE = unbounded */
+	void SetTagBudget(ESignificanceTag SignificanceTag, int32 MaxActive);
+	int32 GetTagBudget(ESignificanceTag SignificanceTag) const { return SignificanceTag < SIG_MAX ? TagConfigs[SignificanceTag].Budget : INDEX_NONE; }
+	void SetTagConfig(ESignificanceTag SignificanceTag, const FSignificanceTagConfig& Config);
+	const FSignificanceTagConfig& GetTagConfig(ESignificanceTag SignificanceTag) const { check(SignificanceTag < SIG_MAX); return TagConfigs[SignificanceTag]; }
+	/* Replaces a tag's scorer. FactorMask tells the gather which inputs the scorer reads (see ESignificanceFactor) */
+	void SetTagScorer(ESignificanceTag SignificanceTag, FSignificanceBucketScorer Scorer, uint32 FactorMask);
+	int32 GetNumRegistered() const { return RegisteredObjects.Num(); }
+	/* Only score objects binned within range of a view (plus whatever was significant last pass) instead of the whole world.
+	 * Everything else implicitly scores zero. Game thread only */
+	void SetSpatialCulling(bool bEnabled, float InCellSize = 5000.f);
+	bool IsSpatialCulling() const { return bSpatialCulling; }
+	/* Writes the per-pass trace ring buffer out oldest first (Shoni.Significance.DumpTrace). False if nothing recorded or the write failed */
+	bool DumpTraceToCSV(const FString& FilePath) const;
+	/* Game thread only */
+	static float GetSignificance(FSignificanceHandle Handle)
 	{
-		if (ObjectLookupTable.Contains(Caller))
+		if (const FSignificanceSlot* Slot = GetSlot(Handle.Index))
 		{
-			int32 Index = ObjectLookupTable[Caller];
-			if (RegisteredObjects.IsValidIndex(Index))
+			if (Slot->Generation.load(std::memory_order_relaxed) == Handle.Generation)
 			{
-				return RegisteredObjects[Index].CachedSignificance;
+				return Slot->Significance;
 			}
-		}		
+		}
 		return 0.f;
 	}
+	/* Hashes the object to find its handle. Prefer keeping the handle from RegisterObject */
+	static float GetSignificance(UObject* Caller)
+	{
+		const FSignificanceHandle* Handle = ObjectLookupTable.Find(Caller);
+		return Handle ? GetSignificance(*Handle) : 0.f;
+	}
+	/* Game thread only. True once the object has registered, whether or not it has been scored yet */
+	static bool IsRegistered(UObject* Caller)
+	{
+		const FSignificanceHandle* Handle = ObjectLookupTable.Find(Caller);
+		return Handle && IsHandleLive(*Handle);
+	}
 
 private:
-	static bool bIsInited;
-	bool bFirstPassComplete;
-	UPROPERTY()
-	TWeakObjectPtr<AActor> CameraActor;
-	FVector CameraLocation_Threadsafe;
-	FVector CameraDirection_Threadsafe;
+	// feeds synthetic objects through the real pass, see ShoniSignificanceBenchmark.cpp
+	friend struct FShoniSignificanceBenchmark;
+
+	bool bIsInited = false;
+	bool bFirstPassComplete = false;
+	TWeakObjectPtr<UWorld> OwningWorld;
+	struct FViewState
+	{
+		TWeakObjectPtr<AActor> Actor;
+		FVector LastLocation = FVector::ZeroVector;
+		double LastSampleTime = -1.0;
+		// smoothed, zeroed on teleports
+		FVector Velocity = FVector::ZeroVector;
+	};
+	TArray<FViewState> ViewStates;
+	float PredictionTime = .3f;
+	float PrefetchScale = 0.f;
+	// anything faster than this between samples is a cut or teleport, not movement
+	const float MAX_PREDICTED_SPEED = 10000.f;
+	/* Game thread only — samples the view's motion and fills in its predicted context */
+	void UpdateViewContext(FViewState& ViewState, double Now, FSignificanceViewContext& OutView) const;
 	FTimerHandle TickTimer;
+	FTimerHandle DrainTimer;
 	const float INTERVAL = .2;
 	const float CAM_DIST_MAX = 20000.f;
 	void CalculateSignificance();
+	/* Game thread only — drains registrations every frame, so adds and removals land between passes rather than a pass later */
+	void DrainRegistrations();
+	/* Game thread only — folds the current queue depths into the next trace sample */
+	void SampleQueueDepths();
+	/* Background thread only — runs each tag's scorer over its range of the async queue */
+	void ScoreTagRanges();
+	/* Background thread only — keeps the top N scores of each budgeted tag and zeroes the rest */
+	int32 ApplyTagBudgets();
+
+	FSignificanceTagConfig TagConfigs[SIG_MAX];
+	FSignificanceTagConfig TagConfigs_Threadsafe[SIG_MAX];
+	FSignificanceBucketScorer TagScorers[SIG_MAX];
+	FSignificanceBucketScorer TagScorers_Threadsafe[SIG_MAX];
+	uint32 TagFactors[SIG_MAX];
+	// one per live view, scored together in a single pass
+	TArray<FSignificanceViewContext> Views_Threadsafe;
+	// contiguous range of each tag inside AsyncTransformQueue
+	int32 TagRangeStart[SIG_MAX];
+	int32 TagRangeNum[SIG_MAX];
+	// recycled per-tag index buckets used for partial selection
+	TArray<int32> TagCandidates[SIG_MAX];
+	// per-tag callbacks for the game thread to dispatch
+	FSignificanceChangeList TagChanges[SIG_MAX];
+	bool bFirstPass_Threadsafe = true;
+	/* Background thread only — diffs the new scores against the previous pass */
+	void BuildChangeLists();
+	/* Game thread only — dispatches the change lists and stores the new scores */
+	void ApplyChangeLists();
+
+	struct FTraceSample
+	{
+		double Time = 0.0;
+		float GatherMs = 0.f;
+		// written on the background thread, read once the pass is back on the game thread
+		float ScoreMs = 0.f;
+		float ApplyMs = 0.f;
+		int32 NumRegistered = 0;
+		int32 NumScored = 0;
+		int32 NumSignificant = 0;
+		int32 Transitions[SIG_MAX] = {};
+		float RegistrationsPerSec = 0.f;
+		float DeregistrationsPerSec = 0.f;
+		int32 AddQueueDepth = 0;
+		int32 RemoveQueueDepth = 0;
+		int32 NumUnrouted = 0;
+	};
+	// ~3 minutes of passes at the default interval
+	static constexpr int32 TRACE_CAPACITY = 1024;
+	TArray<FTraceSample> TraceBuffer;
+	int32 TraceHead = 0;
+	FTraceSample PendingTraceSample;
+	// deepest the queues got since the last pass, they are drained every frame
+	int32 PeakAddQueueDepth = 0;
+	int32 PeakRemoveQueueDepth = 0;
+	double LastTraceTime = 0.0;
+	uint32 LastTotalRegistrations = 0;
+	uint32 LastTotalDeregistrations = 0;
+	/* Game thread only — publishes the finished pass to the stat group and the trace ring */
+	void RecordTraceSample(int32 NumSignificant);
 
-	static TArray<FSignificanceObject> RegisteredObjects;
-	static TMap<TObjectKey<UObject>, int32> ObjectLookupTable;
+	// spatial culling, see SetSpatialCulling
+	bool bSpatialCulling = false;
+	float SpatialCellSize = 5000.f;
+	// 2D like the octree. Cells hold slot indices since dense indices move on swap-removal
+	TMap<FIntPoint, TArray<int32>> SpatialCells;
+	// slots significant after the last pass, always gathered so they can transition out of range
+	TArray<int32> ActiveSlots;
+	// dense indices to gather this pass
+	TArray<int32> CandidateIndices;
+	uint32 GatherPass = 0;
+	// objects that were not gathered get re-binned this many at a time so movers are eventually picked up
+	const int32 REBIN_PER_PASS = 2048;
+	int32 RebinCursor = 0;
+	FIntPoint GetSpatialCell(const FVector& Location) const;
+	void BinObject(FSignificanceObject& SigObj, const FVector& Location);
+	void UnbinObject(FSignificanceObject& SigObj);
+	/* Game thread only — fills CandidateIndices from the cells around each view and the previously active set */
+	void GatherSpatialCandidates();
 
-	TArray<TPair<FTransform, float>> AsyncTransformQueue;
-	static bool bAsyncOperationInProgress;
+	TArray<FSignificanceObject> RegisteredObjects;
+	TArray<FSignificanceAsyncEntry> AsyncTransformQueue;
+	bool bAsyncOperationInProgress = false;
 
-	static TArray<TPair<TWeakObjectPtr<UObject>, ESignificanceTag>> ElementsToAdd;
-	static TArray<TWeakObjectPtr<UObject>> ElementsToRemove;
-	static bool bRequiresUpdate;
+	// routed to this manager by UpdateContainers, applied once no pass is in flight
+	TArray<FSignificancePendingAdd> ElementsToAdd;
+	TArray<FSignificanceHandle> ElementsToRemove;
+	/* Game thread only — applies routed adds and removes to the dense array */
+	void ApplyContainerChanges();
+	/* Game thread only — swap-removes the object and releases its slot */
+	void RemoveRegistered(FSignificanceHandle Handle);
+	/* Hands a live handle's removal to whoever owns it */
+	static void RouteRemoval(FSignificanceHandle Handle);
+	/* Returns false if the object's world has no manager yet */
+	static bool RouteAdd(const FSignificancePendingAdd& PendingAdd);
+
+	// handle slots are process wide so handles stay valid whichever world the object ends up in
+	static constexpr int32 SLOTS_PER_PAGE = 4096;
+	static constexpr int32 MAX_SLOT_PAGES = 128;
+	static std::atomic<FSignificanceSlot*> SlotPages[MAX_SLOT_PAGES];
+	static std::atomic<int32> NumSlotsClaimed;
+	static TLockFreePointerListLIFO<FSignificanceSlot> FreeSlots;
+	static FSignificanceSlot* GetSlot(int32 SlotIndex)
+	{
+		if (SlotIndex < 0 || SlotIndex >= SLOTS_PER_PAGE * MAX_SLOT_PAGES) return nullptr;
+		FSignificanceSlot* Page = SlotPages[SlotIndex / SLOTS_PER_PAGE].load(std::memory_order_acquire);
+		return Page ? Page + SlotIndex % SLOTS_PER_PAGE : nullptr;
+	}
+	static FSignificanceSlot* ClaimSlot();
+	static bool IsHandleLive(FSignificanceHandle Handle)
+	{
+		const FSignificanceSlot* Slot = GetSlot(Handle.Index);
+		return Slot && Slot->Generation.load(std::memory_order_acquire) == Handle.Generation;
+	}
+	static void FreeSlot(FSignificanceSlot& Slot);
+	// only used by the UObject overloads
+	static TMap<TObjectKey<UObject>, FSignificanceHandle> ObjectLookupTable;
+	static TMap<TObjectKey<UWorld>, TWeakObjectPtr<UShoniSignificanceManager>> WorldManagers;
 
-	static bool bDebouncePending;
+	// multi-producer queues, written from any thread and drained by UpdateContainers
+	static TQueue<FSignificancePendingAdd, EQueueMode::Mpsc> AddQueue;
+	static TQueue<FSignificanceHandle, EQueueMode::Mpsc> RemoveQueue;
+	static std::atomic<bool> bRequiresUpdate;
+	// drain buffers, recycled between updates
+	static TArray<FSignificancePendingAdd> DrainedAdds;
+	static TSet<FSignificanceHandle> DrainedRemoves;
+	// instrumentation, see STATGROUP_ShoniSignificance
+	static std::atomic<int32> NumQueuedAdds;
+	static std::atomic<int32> NumQueuedRemoves;
+	static std::atomic<uint32> TotalRegistrations;
+	static std::atomic<uint32> TotalDeregistrations;
+	// adds whose world has no manager yet, retried on every drain
+	static TArray<FSignificancePendingAdd> UnroutedAdds;
+	// game thread only. Objects deregistered before their add was drained
+	static TSet<TObjectKey<UObject>> ObjectsToRemove;
 };
@@ -0,0 +1,242 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+enum ESignificanceTag
+{
+	SIG_Gameplay,
+	SIG_Rendering,
+	SIG_Audio,
+	SIG_Niagara,
+	SIG_MAX
+};
+
+/* Factors a scorer can take into account. Tags only pay for the factors they compile in */
+enum ESignificanceFactor : uint32
+{
+	SF_Distance		= 1 << 0,
+	SF_Facing		= 1 << 1,
+	SF_ScreenSize	= 1 << 2,
+	SF_Importance	= 1 << 3,
+	SF_Recency		= 1 << 4
+};
+
+/* Snapshot of a single object taken on the game thread and scored on the background thread */
+struct FSignificanceAsyncEntry
+{
+	FVector Location = FVector::ZeroVector;
+	// only gathered for tags that score screen size
+	float BoundsRadius = 0.f;
+	// only gathered for tags that score recency. Negative = never rendered / unknown
+	float TimeSinceSeen = -1.f;
+	float Importance = 1.f;
+	// index into RegisteredObjects at the time of the snapshot
+	int32 ObjectIndex = INDEX_NONE;
+	ESignificanceTag SignificanceTag = SIG_Gameplay;
+	// significance applied on the previous pass, used to build the change lists off the game thread
+	float PrevValue = 0.f;
+	bool bWantsValueUpdates = false;
+	float Value = 0.f;
+};
+
+/* Indices into the async queue of everything that needs a callback this pass, built on the background thread */
+struct FSignificanceChangeList
+{
+	TArray<int32> Activated;
+	TArray<int32> Deactivated;
+	TArray<int32> ValueChanged;
+
+	void Reset()
+	{
+		Activated.Reset();
+		Deactivated.Reset();
+		ValueChanged.Reset();
+	}
+
+	int32 NumTransitions() const { return Activated.Num() + Deactivated.Num(); }
+};
+
+/* Camera state copied on the game thread before the background pass */
+struct FSignificanceViewContext
+{
+	FVector Location = FVector::ZeroVector;
+	FVector Direction = FVector::ForwardVector;
+	// tan(FOV / 2), used for projected screen size
+	float TanHalfFOV = 1.f;
+	float MaxDistance = 20000.f;
+	// range is widened by up to PrefetchMargin towards where the camera is heading
+	FVector PrefetchDirection = FVector::ZeroVector;
+	float PrefetchMargin = 0.f;
+};
+
+/* Relative weights of each factor. Distance, screen size and recency are blended, importance scales the blend
+ * and facing shrinks the significance range behind the camera (0 = no effect, 0.5 = half range directly behind) */
+struct FSignificanceFactorWeights
+{
+	float Distance = 1.f;
+	float Facing = .5f;
+	float ScreenSize = 0.f;
+	float Importance = 1.f;
+	float Recency = 0.f;
+};
+
+struct FSignificanceTagConfig
+{
+	FSignificanceFactorWeights Weights;
+	// multiplier on the manager's max camera distance
+	float RangeScale = 1.f;
+	// projected radius (fraction of half screen height) that counts as full screen size significance
+	float FullScreenSize = .25f;
+	// seconds unseen after which recency stops contributing
+	float RecencyWindow = 5.f;
+	// scores at or below this are culled to zero
+	float MinScore = 0.f;
+	// top-K cap on active objects of this tag. INDEX_NONE = unbounded
+	int32 Budget = INDEX_NONE;
+	// false = score only, the owner polls GetSignificance instead of receiving callbacks
+	bool bNotifyTransitions = true;
+};
+
+template<uint32 Factors>
+struct TSignificanceScorer
+{
+	static constexpr uint32 FactorMask = Factors;
+
+	static FORCEINLINE float Score(const FSignificanceAsyncEntry& Entry, const FSignificanceViewContext& View, const FSignificanceTagConfig& Config)
+	{
+		const FSignificanceFactorWeights& W = Config.Weights;
+		const FVector ToObj = Entry.Location - View.Location;
+		const float Dist = ToObj.Size();
+
+		const FVector DirToObj = Dist > KINDA_SMALL_NUMBER ? ToObj / Dist : View.Direction;
+		float MaxDist = View.MaxDistance * Config.RangeScale;
+		if constexpr ((Factors & SF_Facing) != 0)
+		{
+			const float FacingDot = FVector::DotProduct(View.Direction, DirToObj);
+			MaxDist *= FMath::Lerp(1.f - W.Facing, 1.f, (FacingDot + 1.f) * 0.5f);
+		}
+		if (View.PrefetchMargin > 0.f)
+		{
+			MaxDist += View.PrefetchMargin * Config.RangeScale * FMath::Max(FVector::DotProduct(View.PrefetchDirection, DirToObj), 0.f);
+		}
+		if (Dist > MaxDist || MaxDist <= 0.f) return 0.f;
+
+		float Blend = 0.f;
+		float BlendWeight = 0.f;
+		if constexpr ((Factors & SF_Distance) != 0)
+		{
+			// linear falloff
+			Blend += W.Distance * (1.f - Dist / MaxDist);
+			BlendWeight += W.Distance;
+		}
+		if constexpr ((Factors & SF_ScreenSize) != 0)
+		{
+			const float ScreenRadius = Entry.BoundsRadius / (FMath::Max(Dist, 1.f) * View.TanHalfFOV);
+			Blend += W.ScreenSize * FMath::Min(ScreenRadius / Config.FullScreenSize, 1.f);
+			BlendWeight += W.ScreenSize;
+		}
+		if constexpr ((Factors & SF_Recency) != 0)
+		{
+			const float Recency = Entry.TimeSinceSeen < 0.f ? 1.f : 1.f - FMath::Min(Entry.TimeSinceSeen / Config.RecencyWindow, 1.f);
+			Blend += W.Recency * Recency;
+			BlendWeight += W.Recency;
+		}
+		float Result = BlendWeight > 0.f ? Blend / BlendWeight : 1.f;
+		if constexpr ((Factors & SF_Importance) != 0)
+		{
+			Result *= FMath::Lerp(1.f, Entry.Importance, W.Importance);
+		}
+		return Result > Config.MinScore ? Result : 0.f;
+	}
+};
+
+/* Compile-time scorer choice per tag. Each tag's hot loop is instantiated against its own scorer */
+template<ESignificanceTag Tag> struct TSignificanceTagTraits;
+template<> struct TSignificanceTagTraits<SIG_Gameplay>	{ using Scorer = TSignificanceScorer<SF_Distance | SF_Facing | SF_Importance>; };
+template<> struct TSignificanceTagTraits<SIG_Rendering>	{ using Scorer = TSignificanceScorer<SF_Distance | SF_Facing | SF_ScreenSize | SF_Recency>; };
+// audio is omnidirectional, facing does not matter
+template<> struct TSignificanceTagTraits<SIG_Audio>		{ using Scorer = TSignificanceScorer<SF_Distance | SF_Importance>; };
+template<> struct TSignificanceTagTraits<SIG_Niagara>	{ using Scorer = TSignificanceScorer<SF_Facing | SF_ScreenSize>; };
+
+using FSignificanceBucketScorer = void(*)(TArrayView<FSignificanceAsyncEntry> Entries, TArrayView<const FSignificanceViewContext> Views, const FSignificanceTagConfig& Config);
+
+/* Scores every entry against every view while the entry is hot in cache, keeping the best */
+template<typename ScorerType>
+void ScoreSignificanceBucket(TArrayView<FSignificanceAsyncEntry> Entries, TArrayView<const FSignificanceViewContext> Views, const FSignificanceTagConfig& Config)
+{
+	if (Views.Num() == 1)
+	{
+		const FSignificanceViewContext& View = Views[0];
+		for (FSignificanceAsyncEntry& Entry : Entries)
+		{
+			Entry.Value = ScorerType::Score(Entry, View, Config);
+		}
+		return;
+	}
+	for (FSignificanceAsyncEntry& Entry : Entries)
+	{
+		float Best = 0.f;
+		for (const FSignificanceViewContext& View : Views)
+		{
+			Best = FMath::Max(Best, ScorerType::Score(Entry, View, Config));
+		}
+		Entry.Value = Best;
+	}
+}
+
+namespace ShoniSignificance
+{
+	inline FSignificanceBucketScorer GetDefaultScorer(ESignificanceTag Tag)
+	{
+		switch (Tag)
+		{
+		case SIG_Gameplay:	return &ScoreSignificanceBucket<TSignificanceTagTraits<SIG_Gameplay>::Scorer>;
+		case SIG_Rendering:	return &ScoreSignificanceBucket<TSignificanceTagTraits<SIG_Rendering>::Scorer>;
+		case SIG_Audio:		return &ScoreSignificanceBucket<TSignificanceTagTraits<SIG_Audio>::Scorer>;
+		case SIG_Niagara:	return &ScoreSignificanceBucket<TSignificanceTagTraits<SIG_Niagara>::Scorer>;
+		default:			return nullptr;
+		}
+	}
+
+	/* Which expensive inputs the game thread has to gather for a tag's default scorer */
+	inline uint32 GetDefaultFactors(ESignificanceTag Tag)
+	{
+		switch (Tag)
+		{
+		case SIG_Gameplay:	return TSignificanceTagTraits<SIG_Gameplay>::Scorer::FactorMask;
+		case SIG_Rendering:	return TSignificanceTagTraits<SIG_Rendering>::Scorer::FactorMask;
+		case SIG_Audio:		return TSignificanceTagTraits<SIG_Audio>::Scorer::FactorMask;
+		case SIG_Niagara:	return TSignificanceTagTraits<SIG_Niagara>::Scorer::FactorMask;
+		default:			return 0;
+		}
+	}
+
+	/* Defaults that fit what each tag drives */
+	inline FSignificanceTagConfig GetDefaultTagConfig(ESignificanceTag Tag)
+	{
+		FSignificanceTagConfig Config;
+		switch (Tag)
+		{
+		case SIG_Rendering:
+			Config.Weights.ScreenSize = 1.f;
+			Config.Weights.Recency = .5f;
+			break;
+		case SIG_Audio:
+			// sounds fall off well before visuals do
+			Config.RangeScale = .5f;
+			Config.Weights.Facing = 0.f;
+			break;
+		case SIG_Niagara:
+			// spirit VFX are owned by the player controller, which polls the score
+			Config.Weights.ScreenSize = 1.f;
+			Config.MinScore = .01f;
+			Config.bNotifyTransitions = false;
+			break;
+		default:
+			break;
+		}
+		return Config;
+	}
+}